@@ -109,17 +109,20 @@ def grayscale_transform():
         start_time = time.time()
         
         if mode == 'serial':
-            elapsed = image_processing.convert_to_grayscale_serial(input_path, output_path)
+            timing = image_processing.convert_to_grayscale_serial(input_path, output_path)
         else:
-            elapsed = image_processing.convert_to_grayscale(input_path, output_path)
+            timing = image_processing.convert_to_grayscale(input_path, output_path)
         
         end_time = time.time()
         
+        elapsed = timing.total
+        
         return jsonify({
             'success': True,
             'message': f'灰度转换完成 ({mode}模式)',
             'mode': mode,
             'cpp_time': elapsed,
+            'timing': timing.to_dict(),
             'parallel_time': elapsed if mode == 'parallel' else None,
             'serial_time': elapsed if mode == 'serial' else None,
             'total_time': end_time - start_time,
@@ -151,16 +154,18 @@ def grayscale_compare():
         parallel_path = os.path.join(app.config['UPLOAD_FOLDER'], parallel_filename)
         
         start_time = time.time()
-        parallel_elapsed = image_processing.convert_to_grayscale(input_path, parallel_path)
+        parallel_timing = image_processing.convert_to_grayscale(input_path, parallel_path)
         parallel_total = time.time() - start_time
+        parallel_elapsed = parallel_timing.compute
         
         # 串行版本
         serial_filename = f"gray_serial_{os.path.basename(input_path)}"
         serial_path = os.path.join(app.config['UPLOAD_FOLDER'], serial_filename)
         
         start_time = time.time()
-        serial_elapsed = image_processing.convert_to_grayscale_serial(input_path, serial_path)
+        serial_timing = image_processing.convert_to_grayscale_serial(input_path, serial_path)
         serial_total = time.time() - start_time
+        serial_elapsed = serial_timing.compute
         
         # 计算加速比
         speedup = serial_elapsed / parallel_elapsed if parallel_elapsed > 0 else 0
@@ -170,11 +175,13 @@ def grayscale_compare():
             'message': '灰度转换并行vs串行对比完成',
             'parallel': {
                 'time': parallel_elapsed,
+                'timing': parallel_timing.to_dict(),
                 'total_time': parallel_total,
                 'output_file': parallel_filename
             },
             'serial': {
                 'time': serial_elapsed,
+                'timing': serial_timing.to_dict(),
                 'total_time': serial_total,
                 'output_file': serial_filename
             },
@@ -210,17 +217,20 @@ def binary_transform():
         start_time = time.time()
         
         if mode == 'serial':
-            elapsed = image_processing.convert_to_binary_serial(input_path, output_path, threshold)
+            timing = image_processing.convert_to_binary_serial(input_path, output_path, threshold)
         else:
-            elapsed = image_processing.convert_to_binary(input_path, output_path, threshold)
+            timing = image_processing.convert_to_binary(input_path, output_path, threshold)
         
         end_time = time.time()
         
+        elapsed = timing.total
+        
         return jsonify({
             'success': True,
             'message': f'二值化转换完成 ({mode}模式)',
             'threshold': threshold,
             'mode': mode,
+            'timing': timing.to_dict(),
             'parallel_time': elapsed if mode == 'parallel' else None,
             'serial_time': elapsed if mode == 'serial' else None,
             'processing_time': end_time - start_time,
@@ -255,16 +265,18 @@ def binary_compare():
         parallel_path = os.path.join(app.config['UPLOAD_FOLDER'], parallel_filename)
         
         start_time = time.time()
-        parallel_elapsed = image_processing.convert_to_binary(input_path, parallel_path, threshold)
+        parallel_timing = image_processing.convert_to_binary(input_path, parallel_path, threshold)
         parallel_total = time.time() - start_time
+        parallel_elapsed = parallel_timing.compute
         
         # 串行版本
         serial_filename = f"binary_serial_{os.path.basename(input_path)}"
         serial_path = os.path.join(app.config['UPLOAD_FOLDER'], serial_filename)
         
         start_time = time.time()
-        serial_elapsed = image_processing.convert_to_binary_serial(input_path, serial_path, threshold)
+        serial_timing = image_processing.convert_to_binary_serial(input_path, serial_path, threshold)
         serial_total = time.time() - start_time
+        serial_elapsed = serial_timing.compute
         
         # 计算加速比
         speedup = serial_elapsed / parallel_elapsed if parallel_elapsed > 0 else 0
@@ -275,11 +287,13 @@ def binary_compare():
             'threshold': threshold,
             'parallel': {
                 'time': parallel_elapsed,
+                'timing': parallel_timing.to_dict(),
                 'total_time': parallel_total,
                 'output_file': parallel_filename
             },
             'serial': {
                 'time': serial_elapsed,
+                'timing': serial_timing.to_dict(),
                 'total_time': serial_total,
                 'output_file': serial_filename
             },
@@ -315,17 +329,20 @@ def brightness_transform():
         start_time = time.time()
         
         if mode == 'serial':
-            elapsed = image_processing.adjust_brightness_serial(input_path, output_path, adjustment)
+            timing = image_processing.adjust_brightness_serial(input_path, output_path, adjustment)
         else:
-            elapsed = image_processing.adjust_brightness(input_path, output_path, adjustment)
+            timing = image_processing.adjust_brightness(input_path, output_path, adjustment)
         
         end_time = time.time()
         
+        elapsed = timing.total
+        
         return jsonify({
             'success': True,
             'message': f'亮度调整完成 ({mode}模式)',
             'adjustment': adjustment,
             'mode': mode,
+            'timing': timing.to_dict(),
             'parallel_time': elapsed if mode == 'parallel' else None,
             'serial_time': elapsed if mode == 'serial' else None,
             'processing_time': end_time - start_time,
@@ -360,16 +377,18 @@ def brightness_compare():
         parallel_path = os.path.join(app.config['UPLOAD_FOLDER'], parallel_filename)
         
         start_time = time.time()
-        parallel_elapsed = image_processing.adjust_brightness(input_path, parallel_path, adjustment)
+        parallel_timing = image_processing.adjust_brightness(input_path, parallel_path, adjustment)
         parallel_total = time.time() - start_time
+        parallel_elapsed = parallel_timing.compute
         
         # 串行版本
         serial_filename = f"bright_serial_{os.path.basename(input_path)}"
         serial_path = os.path.join(app.config['UPLOAD_FOLDER'], serial_filename)
         
         start_time = time.time()
-        serial_elapsed = image_processing.adjust_brightness_serial(input_path, serial_path, adjustment)
+        serial_timing = image_processing.adjust_brightness_serial(input_path, serial_path, adjustment)
         serial_total = time.time() - start_time
+        serial_elapsed = serial_timing.compute
         
         # 计算加速比
         speedup = serial_elapsed / parallel_elapsed if parallel_elapsed > 0 else 0
@@ -380,11 +399,13 @@ def brightness_compare():
             'adjustment': adjustment,
             'parallel': {
                 'time': parallel_elapsed,
+                'timing': parallel_timing.to_dict(),
                 'total_time': parallel_total,
                 'output_file': parallel_filename
             },
             'serial': {
                 'time': serial_elapsed,
+                'timing': serial_timing.to_dict(),
                 'total_time': serial_total,
                 'output_file': serial_filename
             },
@@ -421,18 +442,21 @@ def gaussian_blur_transform():
         start_time = time.time()
         
         if mode == 'serial':
-            elapsed = image_processing.apply_gaussian_blur_serial(input_path, output_path, kernel_size, sigma)
+            timing = image_processing.apply_gaussian_blur_serial(input_path, output_path, kernel_size, sigma)
         else:
-            elapsed = image_processing.apply_gaussian_blur(input_path, output_path, kernel_size, sigma)
+            timing = image_processing.apply_gaussian_blur(input_path, output_path, kernel_size, sigma)
         
         end_time = time.time()
         
+        elapsed = timing.total
+        
         return jsonify({
             'success': True,
             'message': f'高斯模糊完成 ({mode}模式)',
             'kernel_size': kernel_size,
             'sigma': sigma,
             'mode': mode,
+            'timing': timing.to_dict(),
             'parallel_time': elapsed if mode == 'parallel' else None,
             'serial_time': elapsed if mode == 'serial' else None,
             'processing_time': end_time - start_time,
@@ -468,16 +492,18 @@ def gaussian_blur_compare():
         parallel_path = os.path.join(app.config['UPLOAD_FOLDER'], parallel_filename)
         
         start_time = time.time()
-        parallel_elapsed = image_processing.apply_gaussian_blur(input_path, parallel_path, kernel_size, sigma)
+        parallel_timing = image_processing.apply_gaussian_blur(input_path, parallel_path, kernel_size, sigma)
         parallel_total = time.time() - start_time
+        parallel_elapsed = parallel_timing.compute
         
         # 串行版本
         serial_filename = f"blur_serial_{os.path.basename(input_path)}"
         serial_path = os.path.join(app.config['UPLOAD_FOLDER'], serial_filename)
         
         start_time = time.time()
-        serial_elapsed = image_processing.apply_gaussian_blur_serial(input_path, serial_path, kernel_size, sigma)
+        serial_timing = image_processing.apply_gaussian_blur_serial(input_path, serial_path, kernel_size, sigma)
         serial_total = time.time() - start_time
+        serial_elapsed = serial_timing.compute
         
         # 计算加速比
         speedup = serial_elapsed / parallel_elapsed if parallel_elapsed > 0 else 0
@@ -489,11 +515,13 @@ def gaussian_blur_compare():
             'sigma': sigma,
             'parallel': {
                 'time': parallel_elapsed,
+                'timing': parallel_timing.to_dict(),
                 'total_time': parallel_total,
                 'output_file': parallel_filename
             },
             'serial': {
                 'time': serial_elapsed,
+                'timing': serial_timing.to_dict(),
                 'total_time': serial_total,
                 'output_file': serial_filename
             },
@@ -527,16 +555,19 @@ def sobel_transform():
         start_time = time.time()
         
         if mode == 'serial':
-            elapsed = image_processing.apply_sobel_edge_detection_serial(input_path, output_path)
+            timing = image_processing.apply_sobel_edge_detection_serial(input_path, output_path)
         else:
-            elapsed = image_processing.apply_sobel_edge_detection(input_path, output_path)
+            timing = image_processing.apply_sobel_edge_detection(input_path, output_path)
         
         end_time = time.time()
         
+        elapsed = timing.total
+        
         return jsonify({
             'success': True,
             'message': f'Sobel边缘检测完成 ({mode}模式)',
             'mode': mode,
+            'timing': timing.to_dict(),
             'parallel_time': elapsed if mode == 'parallel' else None,
             'serial_time': elapsed if mode == 'serial' else None,
             'processing_time': end_time - start_time,
@@ -568,16 +599,18 @@ def sobel_compare():
         parallel_path = os.path.join(app.config['UPLOAD_FOLDER'], parallel_filename)
         
         start_time = time.time()
-        parallel_elapsed = image_processing.apply_sobel_edge_detection(input_path, parallel_path)
+        parallel_timing = image_processing.apply_sobel_edge_detection(input_path, parallel_path)
         parallel_total = time.time() - start_time
+        parallel_elapsed = parallel_timing.compute
         
         # 串行版本
         serial_filename = f"sobel_serial_{os.path.basename(input_path)}"
         serial_path = os.path.join(app.config['UPLOAD_FOLDER'], serial_filename)
         
         start_time = time.time()
-        serial_elapsed = image_processing.apply_sobel_edge_detection_serial(input_path, serial_path)
+        serial_timing = image_processing.apply_sobel_edge_detection_serial(input_path, serial_path)
         serial_total = time.time() - start_time
+        serial_elapsed = serial_timing.compute
         
         # 计算加速比
         speedup = serial_elapsed / parallel_elapsed if parallel_elapsed > 0 else 0
@@ -587,11 +620,13 @@ def sobel_compare():
             'message': 'Sobel边缘检测并行vs串行对比完成',
             'parallel': {
                 'time': parallel_elapsed,
+                'timing': parallel_timing.to_dict(),
                 'total_time': parallel_total,
                 'output_file': parallel_filename
             },
             'serial': {
                 'time': serial_elapsed,
+                'timing': serial_timing.to_dict(),
                 'total_time': serial_total,
                 'output_file': serial_filename
             },
@@ -635,18 +670,21 @@ def convolution_transform():
         start_time = time.time()
         
         if mode == 'serial':
-            elapsed = image_processing.apply_custom_convolution_serial(input_path, output_path, kernel, scale)
+            timing = image_processing.apply_custom_convolution_serial(input_path, output_path, kernel, scale)
         else:
-            elapsed = image_processing.apply_custom_convolution(input_path, output_path, kernel, scale)
+            timing = image_processing.apply_custom_convolution(input_path, output_path, kernel, scale)
         
         end_time = time.time()
         
+        elapsed = timing.total
+        
         return jsonify({
             'success': True,
             'message': f'自定义卷积完成 ({mode}模式)',
             'kernel': kernel,
             'scale': scale,
             'mode': mode,
+            'timing': timing.to_dict(),
             'parallel_time': elapsed if mode == 'parallel' else None,
             'serial_time': elapsed if mode == 'serial' else None,
             'processing_time': end_time - start_time,
@@ -689,16 +727,18 @@ def convolution_compare():
         parallel_path = os.path.join(app.config['UPLOAD_FOLDER'], parallel_filename)
         
         start_time = time.time()
-        parallel_elapsed = image_processing.apply_custom_convolution(input_path, parallel_path, kernel, scale)
+        parallel_timing = image_processing.apply_custom_convolution(input_path, parallel_path, kernel, scale)
         parallel_total = time.time() - start_time
+        parallel_elapsed = parallel_timing.compute
         
         # 串行版本
         serial_filename = f"conv_serial_{os.path.basename(input_path)}"
         serial_path = os.path.join(app.config['UPLOAD_FOLDER'], serial_filename)
         
         start_time = time.time()
-        serial_elapsed = image_processing.apply_custom_convolution_serial(input_path, serial_path, kernel, scale)
+        serial_timing = image_processing.apply_custom_convolution_serial(input_path, serial_path, kernel, scale)
         serial_total = time.time() - start_time
+        serial_elapsed = serial_timing.compute
         
         # 计算加速比
         speedup = serial_elapsed / parallel_elapsed if parallel_elapsed > 0 else 0
@@ -710,11 +750,13 @@ def convolution_compare():
             'scale': scale,
             'parallel': {
                 'time': parallel_elapsed,
+                'timing': parallel_timing.to_dict(),
                 'total_time': parallel_total,
                 'output_file': parallel_filename
             },
             'serial': {
                 'time': serial_elapsed,
+                'timing': serial_timing.to_dict(),
                 'total_time': serial_total,
                 'output_file': serial_filename
             },
@@ -747,14 +789,16 @@ def stitch_transform():
         output_path = os.path.join(app.config['UPLOAD_FOLDER'], output_filename)
         
         start_time = time.time()
-        elapsed = image_processing.stitch_images_surf(input_path1, input_path2, output_path)
+        timing = image_processing.stitch_images_surf(input_path1, input_path2, output_path)
         end_time = time.time()
+        elapsed = timing.total
         
         return jsonify({
             'success': True,
             'message': '图像拼接完成',
             'cpp_time': elapsed,
             'parallel_time': elapsed,
+            'timing': timing.to_dict(),
             'total_time': end_time - start_time,
             'output_file': output_filename
         })
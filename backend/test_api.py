@@ -8,11 +8,43 @@ API测试脚本
 import requests
 import json
 import os
+import sys
 import time
+import struct
+import tempfile
+
+# 直接调用C++模块的一致性测试需要从backend目录导入image_processing
+sys.path.append(os.path.dirname(os.path.abspath(__file__)))
+
+try:
+    import image_processing
+    IMAGE_PROCESSING_AVAILABLE = True
+except ImportError as e:
+    print(f"警告: 无法导入image_processing模块: {e}")
+    IMAGE_PROCESSING_AVAILABLE = False
 
 # API基础URL
 BASE_URL = "http://localhost:5000"
 
+# Timing.to_dict()的字段，各处理API在响应的timing中原样返回
+TIMING_KEYS = ["header", "read", "allocation", "compute", "write", "total",
+               "pixels", "bytes", "mb_per_second", "counters"]
+
+def check_timing_dict(timing):
+    """检查分阶段计时：字段齐全，各阶段非负且之和等于total"""
+    if not isinstance(timing, dict):
+        print(f"缺少分阶段计时: {timing}")
+        return False
+    missing = [key for key in TIMING_KEYS if key not in timing]
+    if missing:
+        print(f"计时缺少字段: {missing}")
+        return False
+    phases = [timing[key] for key in ("header", "read", "allocation", "compute", "write")]
+    if min(phases) < 0 or abs(sum(phases) - timing["total"]) > 1e-3:
+        print(f"各阶段耗时之和与total不符: {timing}")
+        return False
+    return True
+
 def test_health_check():
     """测试健康检查API"""
     print("=== 测试健康检查 ===")
@@ -62,6 +94,9 @@ def test_image_processing_api(image_path, api_endpoint, params=None, files_key='
         result = response.json()
         print(f"响应: {result}")
         
+        if response.status_code == 200 and not check_timing_dict(result.get('timing')):
+            return False
+        
         if response.status_code == 200 and 'output_file' in result:
             # 尝试下载处理后的文件
             output_file = result['output_file']
@@ -139,6 +174,9 @@ def test_image_stitching():
         result = response.json()
         print(f"响应: {result}")
         
+        if response.status_code == 200 and not check_timing_dict(result.get('timing')):
+            return False
+        
         if response.status_code == 200 and 'output_file' in result:
             # 尝试下载拼接后的文件
             output_file = result['output_file']
@@ -155,23 +193,202 @@ def test_image_stitching():
         print(f"图像拼接测试失败: {e}")
         return False
 
+def read_bmp_pixels(path):
+    """读取24位或8位BMP的像素，返回(宽, 高, 通道数, 去掉行尾填充的各行字节)"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    offset = struct.unpack_from('<I', data, 10)[0]
+    width, height = struct.unpack_from('<ii', data, 18)
+    channels = struct.unpack_from('<H', data, 28)[0] // 8
+    row_size = (width * channels + 3) // 4 * 4
+    rows = [data[offset + y * row_size:offset + y * row_size + width * channels]
+            for y in range(abs(height))]
+    return width, abs(height), channels, rows
+
+def pixel_difference(path1, path2):
+    """两幅同尺寸BMP逐字节差值的最大值与平均值"""
+    w1, h1, c1, rows1 = read_bmp_pixels(path1)
+    w2, h2, c2, rows2 = read_bmp_pixels(path2)
+    if (w1, h1, c1) != (w2, h2, c2):
+        raise ValueError(f"图像尺寸不同: {(w1, h1, c1)} vs {(w2, h2, c2)}")
+    max_diff, total = 0, 0
+    for r1, r2 in zip(rows1, rows2):
+        for a, b in zip(r1, r2):
+            d = abs(a - b)
+            total += d
+            if d > max_diff:
+                max_diff = d
+    return max_diff, total / (w1 * h1 * c1)
+
+def test_timing_object(test_image, work_dir):
+    """文件处理函数返回Timing对象：float(t)为总耗时，to_dict()与HTTP响应中的timing一致"""
+    timing = image_processing.convert_to_grayscale(test_image, os.path.join(work_dir, "gray.bmp"))
+    print(f"返回: {timing!r}")
+    if abs(float(timing) - timing.total) > 1e-12:
+        print("float(Timing)与total不一致")
+        return False
+    return check_timing_dict(timing.to_dict())
+
+def test_auto_threshold(test_image, work_dir):
+    """自动阈值二值化的结果应与用选出的阈值做固定阈值二值化完全相同"""
+    width, height, _, _ = read_bmp_pixels(test_image)
+    for method in ("otsu", "triangle"):
+        auto_path = os.path.join(work_dir, f"auto_{method}.bmp")
+        fixed_path = os.path.join(work_dir, f"fixed_{method}.bmp")
+        result = image_processing.convert_to_binary_auto(test_image, auto_path, method)
+        threshold = result["threshold"]
+        print(f"{method}阈值: {threshold}")
+        if not check_timing_dict(result["timing"].to_dict()):
+            return False
+        if int(result["histogram"].sum()) != width * height:
+            print("直方图总数与像素数不符")
+            return False
+        image_processing.convert_to_binary(test_image, fixed_path, threshold)
+        max_diff, _ = pixel_difference(auto_path, fixed_path)
+        if max_diff != 0:
+            print(f"{method}自动阈值结果与固定阈值{threshold}不同")
+            return False
+    return True
+
+def test_point_ops(test_image, work_dir):
+    """查找表点运算：输出每个字节都等于build_point_lut给出的表项，表再作为("table", lut)传入结果不变"""
+    ops = [("levels", 10, 240), ("gamma", 0.8), ("curve", [(0, 0), (128, 150), (255, 255)], "g")]
+    lut = image_processing.build_point_lut(ops).tolist()
+    ops_path = os.path.join(work_dir, "point_ops.bmp")
+    table_path = os.path.join(work_dir, "point_table.bmp")
+    image_processing.apply_point_ops(test_image, ops_path, ops)
+    image_processing.apply_point_ops(test_image, table_path, [("table", lut)])
+    
+    _, _, _, src_rows = read_bmp_pixels(test_image)
+    _, _, _, dst_rows = read_bmp_pixels(ops_path)
+    for y, (src, dst) in enumerate(zip(src_rows, dst_rows)):
+        for i, (s, d) in enumerate(zip(src, dst)):
+            if d != lut[i % 3][s]:
+                print(f"第{y}行第{i}字节: {d} != lut[{i % 3}][{s}] = {lut[i % 3][s]}")
+                return False
+    max_diff, _ = pixel_difference(ops_path, table_path)
+    if max_diff != 0:
+        print("以table重新传入查找表的结果不同")
+        return False
+    return True
+
+def test_gaussian_methods(test_image, work_dir):
+    """递归高斯是可分离卷积的近似：平均误差应在1级灰度以内"""
+    separable_path = os.path.join(work_dir, "gauss_separable.bmp")
+    recursive_path = os.path.join(work_dir, "gauss_recursive.bmp")
+    image_processing.apply_gaussian_blur(test_image, separable_path, 25, 5.0, "separable")
+    image_processing.apply_gaussian_blur(test_image, recursive_path, 25, 5.0, "recursive")
+    max_diff, mean_diff = pixel_difference(separable_path, recursive_path)
+    print(f"可分离 vs 递归: 最大差值 {max_diff}, 平均差值 {mean_diff:.4f}")
+    return max_diff <= 12 and mean_diff <= 1.0
+
+def test_convolution_methods(test_image, work_dir):
+    """FFT卷积与直接卷积只有舍入误差：逐像素相差不超过1"""
+    kernels = [
+        ([[0, -1, 0], [-1, 5, -1], [0, -1, 0]], 1.0),
+        ([[1] * 15 for _ in range(15)], 225.0),
+    ]
+    for kernel, divisor in kernels:
+        direct_path = os.path.join(work_dir, "conv_direct.bmp")
+        fft_path = os.path.join(work_dir, "conv_fft.bmp")
+        image_processing.apply_custom_convolution(test_image, direct_path, kernel, divisor, "direct")
+        image_processing.apply_custom_convolution(test_image, fft_path, kernel, divisor, "fft")
+        max_diff, mean_diff = pixel_difference(direct_path, fft_path)
+        print(f"{len(kernel)}x{len(kernel)}卷积核 直接 vs FFT: 最大差值 {max_diff}, 平均差值 {mean_diff:.4f}")
+        if max_diff > 1:
+            return False
+    return True
+
+def test_streaming_pipeline(test_image, work_dir):
+    """按条带流式执行的流水线与整幅图像在内存中执行的结果逐字节相同"""
+    ops = [("gaussian", 5, 1.2), ("sobel",)]
+    memory_path = os.path.join(work_dir, "pipeline_memory.bmp")
+    image_processing.run_pipeline(test_image, memory_path, ops)
+    for budget in (0.05, 1.0):
+        stream_path = os.path.join(work_dir, f"pipeline_stream_{budget}.bmp")
+        timing = image_processing.run_pipeline(test_image, stream_path, ops, memory_budget_mb=budget)
+        max_diff, _ = pixel_difference(memory_path, stream_path)
+        print(f"内存预算{budget}MB: 最大差值 {max_diff}, 计时 {timing!r}")
+        if max_diff != 0 or not check_timing_dict(timing.to_dict()):
+            return False
+    return True
+
+def test_array_dtype():
+    """NumPy数组版本只接受uint8数组，其他类型报TypeError而不是被截断成uint8"""
+    import numpy as np
+    ops = [("gamma", 0.8)]
+    lut = image_processing.build_point_lut(ops)
+    image = np.random.default_rng(0).integers(0, 256, (64, 48, 3), dtype=np.uint8)
+    expected = np.stack([lut[c][image[..., c]] for c in range(3)], axis=-1)
+    if not np.array_equal(image_processing.apply_point_ops(image, ops), expected):
+        print("数组版本点运算结果与查找表不符")
+        return False
+    
+    try:
+        image_processing.apply_point_ops(image.astype(np.float32), ops)
+        print("float32数组没有被拒绝")
+        return False
+    except TypeError:
+        return True
+
+def test_module_consistency():
+    """直接调用C++模块，检查各实现方式之间结果一致"""
+    print("\n=== 测试C++模块结果一致性 ===")
+    
+    if not IMAGE_PROCESSING_AVAILABLE:
+        print("image_processing模块不可用，跳过")
+        return False
+    
+    test_image = "1.bmp"
+    if not os.path.exists(test_image):
+        print(f"测试图片不存在: {test_image}")
+        return False
+    
+    work_dir = tempfile.mkdtemp(prefix="image_processing_test_")
+    tests = [
+        ("Timing返回值", lambda: test_timing_object(test_image, work_dir)),
+        ("自动阈值", lambda: test_auto_threshold(test_image, work_dir)),
+        ("查找表点运算", lambda: test_point_ops(test_image, work_dir)),
+        ("递归与可分离高斯", lambda: test_gaussian_methods(test_image, work_dir)),
+        ("FFT与直接卷积", lambda: test_convolution_methods(test_image, work_dir)),
+        ("流式流水线", lambda: test_streaming_pipeline(test_image, work_dir)),
+        ("数组类型检查", test_array_dtype),
+    ]
+    
+    success_count = 0
+    for name, test in tests:
+        print(f"\n--- 测试{name} ---")
+        try:
+            success = test()
+        except Exception as e:
+            print(f"{name}测试失败: {e}")
+            success = False
+        print("通过" if success else "失败")
+        if success:
+            success_count += 1
+    
+    print(f"\n模块一致性测试完成: {success_count}/{len(tests)} 成功")
+    return success_count == len(tests)
+
 def main():
     """主函数"""
     print("开始API测试...")
     
     # 测试健康检查
-    if not test_health_check():
-        print("健康检查失败，请确保服务器正在运行")
-        return
-    
-    # 测试OpenMP线程数
-    test_omp_threads()
-    
-    # 测试图像处理功能
-    test_all_image_processing()
+    if test_health_check():
+        # 测试OpenMP线程数
+        test_omp_threads()
+        
+        # 测试图像处理功能
+        test_all_image_processing()
+        
+        # 测试图像拼接
+        test_image_stitching()
+    else:
+        print("健康检查失败，请确保服务器正在运行，跳过HTTP接口测试")
     
-    # 测试图像拼接
-    test_image_stitching()
+    # 直接调用C++模块的测试不需要服务器
+    test_module_consistency()
     
     print("\n所有测试完成！")
 
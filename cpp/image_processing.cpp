@@ -1,1783 +1,5611 @@
-#include <pybind11/pybind11.h>
-#include <pybind11/stl.h>
-#include <pybind11/numpy.h>
-#include <omp.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <math.h>
-#include <malloc.h>
-#include <opencv2/opencv.hpp>
-#include <opencv2/features2d.hpp>
-#include <time.h>
-#include <string>
-#include <stdint.h>
-
-namespace py = pybind11;
-using namespace cv;
-
-#pragma pack(1)
-typedef struct
-{
-    unsigned char bfType[2];      // "BM"
-    uint32_t bfSize;              // 文件大小
-    uint16_t bfReserved1;         // 保留字段1
-    uint16_t bfReserved2;         // 保留字段2
-    uint32_t bfOffBits;           // 数据偏移量
-} fileHeader;
-
-typedef struct
-{
-    uint32_t biSize;              // 信息头大小
-    int32_t biWidth;              // 图像宽度
-    int32_t biHeight;             // 图像高度
-    uint16_t biPlanes;            // 平面数
-    uint16_t biBitCount;          // 每像素位数
-    uint32_t biCompression;       // 压缩类型
-    uint32_t biSizeImage;         // 图像数据大小
-    int32_t biXPixPerMeter;       // 水平分辨率
-    int32_t biYPixPerMeter;       // 垂直分辨率
-    uint32_t biClrUsed;           // 使用的颜色数
-    uint32_t biClrImportant;      // 重要颜色数
-} fileInfo;
-
-typedef struct
-{
-    unsigned char rgbBlue;
-    unsigned char rgbGreen;
-    unsigned char rgbRed;
-    unsigned char rgbReserved;
-} rgbq;
-#pragma pack()
-
-unsigned char clamp(int val)
-{
-    if (val < 0)
-        return 0;
-    if (val > 255)
-        return 255;
-    return (unsigned char)val;
-}
-
-void write_bmp_header(FILE *fp, fileHeader *fh, fileInfo *fi, rgbq *palette)
-{
-    fwrite(fh, sizeof(fileHeader), 1, fp);
-    fwrite(fi, sizeof(fileInfo), 1, fp);
-    fwrite(palette, sizeof(rgbq), 256, fp);
-}
-
-// 封装为Python可调用的函数
-double convert_to_grayscale_py(const std::string &input, const std::string &output)
-{
-    FILE *in = NULL, *out = NULL;
-    in = fopen(input.c_str(), "rb");
-    if (!in)
-    {
-        throw std::runtime_error("无法打开输入文件: " + input);
-    }
-    out = fopen(output.c_str(), "wb");
-    if (!out)
-    {
-        fclose(in);
-        throw std::runtime_error("无法创建输出文件: " + output);
-    }
-
-    fileHeader *fh = (fileHeader *)malloc(sizeof(fileHeader));
-    fileInfo *fi = (fileInfo *)malloc(sizeof(fileInfo));
-    fread(fh, sizeof(fileHeader), 1, in);
-    fread(fi, sizeof(fileInfo), 1, in);
-
-    double start_time, end_time;
-    start_time = omp_get_wtime();
-    int width = fi->biWidth, height = fi->biHeight;
-    int rowSize = ((width * 3 + 3) / 4) * 4;
-
-    // 初始化新的文件头
-    fileHeader newFh;
-    fileInfo newFi;
-    
-    // 复制文件头信息
-    memcpy(&newFh, fh, sizeof(fileHeader));
-    memcpy(&newFi, fi, sizeof(fileInfo));
-    
-    // 设置新的参数
-    newFi.biBitCount = 8;
-    newFi.biCompression = 0;
-    newFi.biSizeImage = ((width + 3) / 4) * 4 * height;
-    newFi.biPlanes = 1;
-    newFi.biClrUsed = 256;
-    newFi.biClrImportant = 256;
-    
-    newFh.bfOffBits = sizeof(fileHeader) + sizeof(fileInfo) + 256 * sizeof(rgbq);
-    newFh.bfSize = newFh.bfOffBits + newFi.biSizeImage;
-
-    rgbq *palette = (rgbq *)malloc(256 * sizeof(rgbq));
-#pragma omp parallel for
-    for (int i = 0; i < 256; i++)
-    {
-        palette[i].rgbRed = palette[i].rgbGreen = palette[i].rgbBlue = i;
-        palette[i].rgbReserved = 0;
-    }
-
-    fwrite(&newFh, sizeof(fileHeader), 1, out);
-    fwrite(&newFi, sizeof(fileInfo), 1, out);
-    fwrite(palette, sizeof(rgbq), 256, out);
-
-    // 分配内存并读取整个图像
-    unsigned char *rgbData = (unsigned char *)malloc(rowSize * height);
-    unsigned char *grayData = (unsigned char *)malloc(((width + 3) / 4) * 4 * height);
-    
-    // 读取所有行
-    bool bottom_up = (fi->biHeight > 0);
-    int actual_height = abs(fi->biHeight);
-    
-    if (bottom_up) {
-        // 图像数据从下到上存储，需要从后往前读取
-        for (int i = actual_height - 1; i >= 0; i--)
-        {
-            fread(rgbData + i * rowSize, 1, rowSize, in);
-        }
-    } else {
-        // 图像数据从上到下存储，正常读取
-        for (int i = 0; i < actual_height; i++)
-        {
-            fread(rgbData + i * rowSize, 1, rowSize, in);
-        }
-    }
-
-    // 并行处理像素转换
-#pragma omp parallel for collapse(2)
-    for (int i = 0; i < height; i++)
-    {
-        for (int j = 0; j < width; j++)
-        {
-            int b = rgbData[i * rowSize + j * 3];
-            int g = rgbData[i * rowSize + j * 3 + 1];
-            int r = rgbData[i * rowSize + j * 3 + 2];
-            grayData[i * ((width + 3) / 4) * 4 + j] = (r + g + b) / 3;
-        }
-    }
-
-    // 写入输出文件
-    for (int i = height - 1; i >= 0; i--)
-    {
-        fwrite(grayData + i * ((width + 3) / 4) * 4, 1, ((width + 3) / 4) * 4, out);
-    }
-    
-    end_time = omp_get_wtime();
-    double elapsed_time = end_time - start_time;
-
-    free(fh);
-    free(fi);
-    free(palette);
-    free(rgbData);
-    free(grayData);
-    fclose(in);
-    fclose(out);
-
-    return elapsed_time;
-}
-
-double convert_to_binary_py(const std::string &input, const std::string &output, int threshold)
-{
-    double start_time, end_time;
-    start_time = omp_get_wtime();
-    
-    FILE *in = NULL, *out = NULL;
-    in = fopen(input.c_str(), "rb");
-    if (!in)
-    {
-        throw std::runtime_error("无法打开输入文件: " + input);
-    }
-    out = fopen(output.c_str(), "wb");
-    if (!out)
-    {
-        fclose(in);
-        throw std::runtime_error("无法创建输出文件: " + output);
-    }
-
-    fileHeader *fh = (fileHeader *)malloc(sizeof(fileHeader));
-    fileInfo *fi = (fileInfo *)malloc(sizeof(fileInfo));
-    fread(fh, sizeof(fileHeader), 1, in);
-    fread(fi, sizeof(fileInfo), 1, in);
-
-    int width = fi->biWidth, height = fi->biHeight;
-    int rowSize = ((width * 3 + 3) / 4) * 4;
-
-    // 初始化新的文件头
-    fileHeader newFh;
-    fileInfo newFi;
-    
-    // 复制文件头信息
-    memcpy(&newFh, fh, sizeof(fileHeader));
-    memcpy(&newFi, fi, sizeof(fileInfo));
-    
-    // 设置新的参数
-    newFi.biBitCount = 8;
-    newFi.biCompression = 0;
-    newFi.biSizeImage = ((width + 3) / 4) * 4 * height;
-    newFi.biPlanes = 1;
-    newFi.biClrUsed = 256;
-    newFi.biClrImportant = 256;
-    
-    newFh.bfOffBits = sizeof(fileHeader) + sizeof(fileInfo) + 256 * sizeof(rgbq);
-    newFh.bfSize = newFh.bfOffBits + newFi.biSizeImage;
-
-    rgbq *palette = (rgbq *)malloc(256 * sizeof(rgbq));
-#pragma omp parallel for
-    for (int i = 0; i < 256; i++)
-    {
-        palette[i].rgbRed = palette[i].rgbGreen = palette[i].rgbBlue = i;
-        palette[i].rgbReserved = 0;
-    }
-
-    fwrite(&newFh, sizeof(fileHeader), 1, out);
-    fwrite(&newFi, sizeof(fileInfo), 1, out);
-    fwrite(palette, sizeof(rgbq), 256, out);
-
-    // 分配内存并读取整个图像
-    unsigned char *rgbData = (unsigned char *)malloc(rowSize * height);
-    unsigned char *binData = (unsigned char *)malloc(((width + 3) / 4) * 4 * height);
-
-    // 读取所有行
-    bool bottom_up = (fi->biHeight > 0);
-    int actual_height = abs(fi->biHeight);
-    
-    if (bottom_up) {
-        // 图像数据从下到上存储，需要从后往前读取
-        for (int i = actual_height - 1; i >= 0; i--)
-        {
-            fread(rgbData + i * rowSize, 1, rowSize, in);
-        }
-    } else {
-        // 图像数据从上到下存储，正常读取
-        for (int i = 0; i < actual_height; i++)
-        {
-            fread(rgbData + i * rowSize, 1, rowSize, in);
-        }
-    }
-
-    // 并行处理像素转换
-#pragma omp parallel for collapse(2)
-    for (int i = 0; i < height; i++)
-    {
-        for (int j = 0; j < width; j++)
-        {
-            int b = rgbData[i * rowSize + j * 3];
-            int g = rgbData[i * rowSize + j * 3 + 1];
-            int r = rgbData[i * rowSize + j * 3 + 2];
-            int gray = (r + g + b) / 3;
-            binData[i * ((width + 3) / 4) * 4 + j] = (gray >= threshold) ? 255 : 0;
-        }
-    }
-
-    // 写入输出文件
-    for (int i = height - 1; i >= 0; i--)
-    {
-        fwrite(binData + i * ((width + 3) / 4) * 4, 1, ((width + 3) / 4) * 4, out);
-    }
-
-    free(fh);
-    free(fi);
-    free(palette);
-    free(rgbData);
-    free(binData);
-    fclose(in);
-    fclose(out);
-    
-    end_time = omp_get_wtime();
-    return end_time - start_time;
-}
-
-double adjust_brightness_py(const std::string &input, const std::string &output, int delta)
-{
-    double start_time, end_time;
-    start_time = omp_get_wtime();
-    
-    FILE *in = NULL, *out = NULL;
-    in = fopen(input.c_str(), "rb");
-    if (!in)
-    {
-        throw std::runtime_error("无法打开输入文件: " + input);
-    }
-    out = fopen(output.c_str(), "wb");
-    if (!out)
-    {
-        fclose(in);
-        throw std::runtime_error("无法创建输出文件: " + output);
-    }
-
-    fileHeader fh;
-    fileInfo fi;
-    fread(&fh, sizeof(fileHeader), 1, in);
-    fread(&fi, sizeof(fileInfo), 1, in);
-
-    if (fi.biBitCount != 24)
-    {
-        fclose(in);
-        fclose(out);
-        throw std::runtime_error("仅支持24位RGB图像亮度调整");
-    }
-
-    int width = fi.biWidth, height = fi.biHeight;
-    int rowSize = ((width * 3 + 3) / 4) * 4;
-
-    fwrite(&fh, sizeof(fileHeader), 1, out);
-    fwrite(&fi, sizeof(fileInfo), 1, out);
-
-    // 分配内存并读取整个图像
-    unsigned char *imageData = (unsigned char *)malloc(rowSize * height);
-    
-    // 读取所有行
-    bool bottom_up = (fi.biHeight > 0);
-    int actual_height = abs(fi.biHeight);
-    
-    if (bottom_up) {
-        // 图像数据从下到上存储，需要从后往前读取
-        for (int i = actual_height - 1; i >= 0; i--)
-        {
-            fread(imageData + i * rowSize, 1, rowSize, in);
-        }
-    } else {
-        // 图像数据从上到下存储，正常读取
-        for (int i = 0; i < actual_height; i++)
-        {
-            fread(imageData + i * rowSize, 1, rowSize, in);
-        }
-    }
-
-    // 并行处理图像数据
-#pragma omp parallel for collapse(2)
-    for (int i = 0; i < height; i++)
-    {
-        for (int j = 0; j < width; j++)
-        {
-            unsigned char *pixel = imageData + i * rowSize + j * 3;
-            pixel[0] = clamp(pixel[0] + delta);
-            pixel[1] = clamp(pixel[1] + delta);
-            pixel[2] = clamp(pixel[2] + delta);
-        }
-    }
-
-    // 写入输出文件
-    for (int i = height - 1; i >= 0; i--)
-    {
-        fwrite(imageData + i * rowSize, 1, rowSize, out);
-    }
-
-    free(imageData);
-    fclose(in);
-    fclose(out);
-    
-    end_time = omp_get_wtime();
-    return end_time - start_time;
-}
-
-void generate_gaussian_kernel(float **kernel, int size, float sigma)
-{
-    int half = size / 2;
-    float sum = 0.0f;
-
-#pragma omp parallel for reduction(+ : sum) collapse(2)
-    for (int i = -half; i <= half; i++)
-    {
-        for (int j = -half; j <= half; j++)
-        {
-            float value = expf(-(i * i + j * j) / (2 * sigma * sigma));
-            kernel[i + half][j + half] = value;
-            sum += value;
-        }
-    }
-
-#pragma omp parallel for collapse(2)
-    for (int i = 0; i < size; i++)
-    {
-        for (int j = 0; j < size; j++)
-        {
-            kernel[i][j] /= sum;
-        }
-    }
-}
-
-double apply_gaussian_blur_py(const std::string &input, const std::string &output, int kernel_size, float sigma)
-{
-    double start_time, end_time;
-    start_time = omp_get_wtime();
-    
-    FILE *in = NULL, *out = NULL;
-    in = fopen(input.c_str(), "rb");
-    if (!in)
-    {
-        throw std::runtime_error("无法打开输入文件: " + input);
-    }
-    out = fopen(output.c_str(), "wb");
-    if (!out)
-    {
-        fclose(in);
-        throw std::runtime_error("无法创建输出文件: " + output);
-    }
-
-    fileHeader fh;
-    fileInfo fi;
-    fread(&fh, sizeof(fileHeader), 1, in);
-    fread(&fi, sizeof(fileInfo), 1, in);
-
-    if (fi.biBitCount != 24)
-    {
-        fclose(in);
-        fclose(out);
-        throw std::runtime_error("仅支持24位RGB图像进行高斯模糊");
-    }
-
-    int width = fi.biWidth, height = fi.biHeight;
-    int rowSize = ((width * 3 + 3) / 4) * 4;
-
-    fwrite(&fh, sizeof(fileHeader), 1, out);
-    fwrite(&fi, sizeof(fileInfo), 1, out);
-
-    unsigned char *src = (unsigned char *)malloc(rowSize * height);
-    unsigned char *dst = (unsigned char *)malloc(rowSize * height);
-    
-    // BMP格式的图像数据可能是从下到上存储的，需要检查biHeight的符号
-    bool bottom_up = (fi.biHeight > 0);
-    int actual_height = abs(fi.biHeight);
-    
-    if (bottom_up) {
-        // 图像数据从下到上存储，需要从后往前读取
-        for (int i = actual_height - 1; i >= 0; i--)
-        {
-            fread(src + i * rowSize, 1, rowSize, in);
-        }
-    } else {
-        // 图像数据从上到下存储，正常读取
-        for (int i = 0; i < actual_height; i++)
-        {
-            fread(src + i * rowSize, 1, rowSize, in);
-        }
-    }
-
-    // 动态分配卷积核内存
-    float **kernel = (float **)malloc(kernel_size * sizeof(float *));
-    for (int i = 0; i < kernel_size; i++) {
-        kernel[i] = (float *)malloc(kernel_size * sizeof(float));
-    }
-    
-    generate_gaussian_kernel(kernel, kernel_size, sigma);
-    int half = kernel_size / 2;
-
-#pragma omp parallel for
-    for (int y = 0; y < height; y++)
-    {
-        for (int x = 0; x < width; x++)
-        {
-            float sumB = 0, sumG = 0, sumR = 0;
-            for (int i = -half; i <= half; i++)
-            {
-                for (int j = -half; j <= half; j++)
-                {
-                    int ny = y + i;
-                    int nx = x + j;
-                    if (nx < 0)
-                        nx = 0;
-                    if (ny < 0)
-                        ny = 0;
-                    if (nx >= width)
-                        nx = width - 1;
-                    if (ny >= height)
-                        ny = height - 1;
-                    unsigned char *p = src + ny * rowSize + nx * 3;
-                    float weight = kernel[i + half][j + half];
-                    sumB += p[0] * weight;
-                    sumG += p[1] * weight;
-                    sumR += p[2] * weight;
-                }
-            }
-            unsigned char *outPix = dst + y * rowSize + x * 3;
-            outPix[0] = clamp((int)(sumB + 0.5));
-            outPix[1] = clamp((int)(sumG + 0.5));
-            outPix[2] = clamp((int)(sumR + 0.5));
-        }
-    }
-
-    // BMP文件要求图像数据从下到上存储
-    for (int i = height - 1; i >= 0; i--)
-    {
-        fwrite(dst + i * rowSize, 1, rowSize, out);
-    }
-
-    // 释放卷积核内存
-    for (int i = 0; i < kernel_size; i++) {
-        free(kernel[i]);
-    }
-    free(kernel);
-    
-    free(src);
-    free(dst);
-    fclose(in);
-    fclose(out);
-    
-    end_time = omp_get_wtime();
-    return end_time - start_time;
-}
-
-double apply_custom_convolution_py(const std::string &input, const std::string &output,
-                                 const std::vector<std::vector<int>> &kernel_vec, float divisor)
-{
-    double start_time, end_time;
-    start_time = omp_get_wtime();
-    
-    FILE *in = NULL, *out = NULL;
-    in = fopen(input.c_str(), "rb");
-    if (!in)
-    {
-        throw std::runtime_error("无法打开输入文件: " + input);
-    }
-    out = fopen(output.c_str(), "wb");
-    if (!out)
-    {
-        fclose(in);
-        throw std::runtime_error("无法创建输出文件: " + output);
-    }
-
-    fileHeader fh;
-    fileInfo fi;
-    fread(&fh, sizeof(fileHeader), 1, in);
-    fread(&fi, sizeof(fileInfo), 1, in);
-
-    if (fi.biBitCount != 24)
-    {
-        fclose(in);
-        fclose(out);
-        throw std::runtime_error("仅支持24位RGB图像进行卷积操作");
-    }
-
-    int width = fi.biWidth, height = fi.biHeight;
-    int rowSize = ((width * 3 + 3) / 4) * 4;
-
-    fwrite(&fh, sizeof(fileHeader), 1, out);
-    fwrite(&fi, sizeof(fileInfo), 1, out);
-
-    unsigned char *src = (unsigned char *)malloc(rowSize * height);
-    unsigned char *dst = (unsigned char *)malloc(rowSize * height);
-    
-    // BMP格式的图像数据可能是从下到上存储的，需要检查biHeight的符号
-    bool bottom_up = (fi.biHeight > 0);
-    int actual_height = abs(fi.biHeight);
-    
-    if (bottom_up) {
-        // 图像数据从下到上存储，需要从后往前读取
-        for (int i = actual_height - 1; i >= 0; i--)
-        {
-            fread(src + i * rowSize, 1, rowSize, in);
-        }
-    } else {
-        // 图像数据从上到下存储，正常读取
-        for (int i = 0; i < actual_height; i++)
-        {
-            fread(src + i * rowSize, 1, rowSize, in);
-        }
-    }
-    memset(dst, 0, rowSize * height);
-
-    // 将vector转换为数组
-    int kernel[3][3];
-    for (int i = 0; i < 3; i++)
-    {
-        for (int j = 0; j < 3; j++)
-        {
-            kernel[i][j] = kernel_vec[i][j];
-        }
-    }
-
-#pragma omp parallel for collapse(2)
-    for (int y = 1; y < height - 1; y++)
-    {
-        for (int x = 1; x < width - 1; x++)
-        {
-            int sumR = 0, sumG = 0, sumB = 0;
-            for (int i = -1; i <= 1; i++)
-            {
-                for (int j = -1; j <= 1; j++)
-                {
-                    int ny = y + i;
-                    int nx = x + j;
-                    unsigned char *p = src + ny * rowSize + nx * 3;
-                    sumB += p[0] * kernel[i + 1][j + 1];
-                    sumG += p[1] * kernel[i + 1][j + 1];
-                    sumR += p[2] * kernel[i + 1][j + 1];
-                }
-            }
-            unsigned char *outPix = dst + y * rowSize + x * 3;
-            outPix[0] = clamp(sumB / divisor);
-            outPix[1] = clamp(sumG / divisor);
-            outPix[2] = clamp(sumR / divisor);
-        }
-    }
-
-    // BMP文件要求图像数据从下到上存储
-    for (int i = height - 1; i >= 0; i--)
-    {
-        fwrite(dst + i * rowSize, 1, rowSize, out);
-    }
-    free(src);
-    free(dst);
-    fclose(in);
-    fclose(out);
-    
-    end_time = omp_get_wtime();
-    return end_time - start_time;
-}
-
-double apply_sobel_edge_detection_py(const std::string &input, const std::string &output)
-{
-    double start_time, end_time;
-    start_time = omp_get_wtime();
-    
-    FILE *in = NULL, *out = NULL;
-    in = fopen(input.c_str(), "rb");
-    if (!in)
-    {
-        throw std::runtime_error("无法打开输入文件: " + input);
-    }
-    out = fopen(output.c_str(), "wb");
-    if (!out)
-    {
-        fclose(in);
-        throw std::runtime_error("无法创建输出文件: " + output);
-    }
-
-    fileHeader fh;
-    fileInfo fi;
-    fread(&fh, sizeof(fileHeader), 1, in);
-    fread(&fi, sizeof(fileInfo), 1, in);
-
-    if (fi.biBitCount != 24)
-    {
-        fclose(in);
-        fclose(out);
-        throw std::runtime_error("仅支持24位RGB图像进行Sobel边缘检测");
-    }
-
-    int width = fi.biWidth, height = fi.biHeight;
-    int rowSize = ((width * 3 + 3) / 4) * 4;
-
-    fwrite(&fh, sizeof(fileHeader), 1, out);
-    fwrite(&fi, sizeof(fileInfo), 1, out);
-
-    unsigned char *src = (unsigned char *)malloc(rowSize * height);
-    unsigned char *dst = (unsigned char *)malloc(rowSize * height);
-    
-    // BMP格式的图像数据可能是从下到上存储的，需要检查biHeight的符号
-    bool bottom_up = (fi.biHeight > 0);
-    int actual_height = abs(fi.biHeight);
-    
-    if (bottom_up) {
-        // 图像数据从下到上存储，需要从后往前读取
-        for (int i = actual_height - 1; i >= 0; i--)
-        {
-            fread(src + i * rowSize, 1, rowSize, in);
-        }
-    } else {
-        // 图像数据从上到下存储，正常读取
-        for (int i = 0; i < actual_height; i++)
-        {
-            fread(src + i * rowSize, 1, rowSize, in);
-        }
-    }
-    memset(dst, 0, rowSize * height);
-
-    int Gx[3][3] = {
-        {-1, 0, 1},
-        {-2, 0, 2},
-        {-1, 0, 1}};
-
-    int Gy[3][3] = {
-        {-1, -2, -1},
-        {0, 0, 0},
-        {1, 2, 1}};
-
-#pragma omp parallel for collapse(2)
-    for (int y = 1; y < height - 1; y++)
-    {
-        for (int x = 1; x < width - 1; x++)
-        {
-            int gx = 0, gy = 0;
-            for (int i = -1; i <= 1; i++)
-            {
-                for (int j = -1; j <= 1; j++)
-                {
-                    int ny = y + i;
-                    int nx = x + j;
-                    unsigned char *p = src + ny * rowSize + nx * 3;
-                    int gray = (p[0] + p[1] + p[2]) / 3;
-                    gx += gray * Gx[i + 1][j + 1];
-                    gy += gray * Gy[i + 1][j + 1];
-                }
-            }
-            int magnitude = (int)sqrt(gx * gx + gy * gy);
-            unsigned char edge = clamp(magnitude);
-            unsigned char *outPix = dst + y * rowSize + x * 3;
-            outPix[0] = outPix[1] = outPix[2] = edge;
-        }
-    }
-
-    // BMP文件要求图像数据从下到上存储
-    for (int i = height - 1; i >= 0; i--)
-    {
-        fwrite(dst + i * rowSize, 1, rowSize, out);
-    }
-
-    free(src);
-    free(dst);
-    fclose(in);
-    fclose(out);
-    
-    end_time = omp_get_wtime();
-    return end_time - start_time;
-}
-
-// 拼接优化相关结构体与全局变量
-typedef struct
-{
-    cv::Point2f left_top;
-    cv::Point2f left_bottom;
-    cv::Point2f right_top;
-    cv::Point2f right_bottom;
-} four_corners_t;
-
-four_corners_t corners;
-
-void OptimizeSeam(cv::Mat &img1, cv::Mat &trans, cv::Mat &dst)
-{
-    // 计算重叠区域的起始位置
-    int start = std::max(0, (int)std::min(corners.left_top.x, corners.left_bottom.x));
-    int end = std::min(dst.cols, (int)std::max(corners.right_top.x, corners.right_bottom.x));
-    
-    if (start >= end) {
-        return; // 没有重叠区域
-    }
-    
-    double processWidth = end - start;
-    int rows = dst.rows;
-    double alpha = 1;
-    
-    for (int i = 0; i < rows; i++)
-    {
-        for (int j = start; j < end; j++)
-        {
-            if (j >= dst.cols) break;
-            
-            // 检查transformed图像中是否有有效像素
-            bool has_trans_pixel = false;
-            if (j < trans.cols && i < trans.rows) {
-                uchar *t = trans.ptr<uchar>(i);
-                has_trans_pixel = (t[j * 3] != 0 || t[j * 3 + 1] != 0 || t[j * 3 + 2] != 0);
-            }
-            
-            if (!has_trans_pixel)
-            {
-                alpha = 1;
-            }
-            else
-            {
-                alpha = (processWidth - (j - start)) / processWidth;
-                alpha = std::max(0.0, std::min(1.0, alpha)); // 限制在[0,1]范围内
-            }
-            
-            uchar *d = dst.ptr<uchar>(i);
-            if (j < img1.cols && i < img1.rows) {
-                uchar *p = img1.ptr<uchar>(i);
-                d[j * 3] = p[j * 3] * alpha + (has_trans_pixel ? trans.ptr<uchar>(i)[j * 3] * (1 - alpha) : 0);
-                d[j * 3 + 1] = p[j * 3 + 1] * alpha + (has_trans_pixel ? trans.ptr<uchar>(i)[j * 3 + 1] * (1 - alpha) : 0);
-                d[j * 3 + 2] = p[j * 3 + 2] * alpha + (has_trans_pixel ? trans.ptr<uchar>(i)[j * 3 + 2] * (1 - alpha) : 0);
-            }
-        }
-    }
-}
-
-void CalcCorners(const cv::Mat &H, const cv::Mat &src)
-{
-    double v2[] = {0, 0, 1};
-    double v1[3];
-    cv::Mat V2 = cv::Mat(3, 1, CV_64FC1, v2);
-    cv::Mat V1 = cv::Mat(3, 1, CV_64FC1, v1);
-    V1 = H * V2;
-    corners.left_top.x = v1[0] / v1[2];
-    corners.left_top.y = v1[1] / v1[2];
-
-    v2[0] = 0;
-    v2[1] = src.rows;
-    V1 = H * cv::Mat(3, 1, CV_64FC1, v2);
-    corners.left_bottom.x = v1[0] / v1[2];
-    corners.left_bottom.y = v1[1] / v1[2];
-
-    v2[0] = src.cols;
-    v2[1] = 0;
-    V1 = H * cv::Mat(3, 1, CV_64FC1, v2);
-    corners.right_top.x = v1[0] / v1[2];
-    corners.right_top.y = v1[1] / v1[2];
-
-    v2[0] = src.cols;
-    v2[1] = src.rows;
-    V1 = H * cv::Mat(3, 1, CV_64FC1, v2);
-    corners.right_bottom.x = v1[0] / v1[2];
-    corners.right_bottom.y = v1[1] / v1[2];
-}
-
-double stitch_images_surf_py(const std::string &input1, const std::string &input2, const std::string &output)
-{
-    cv::Mat image01 = cv::imread(input1);
-    cv::Mat image02 = cv::imread(input2);
-    if (image01.empty() || image02.empty())
-    {
-        throw std::runtime_error("无法读取输入图像");
-    }
-
-    double start_time = omp_get_wtime();
-
-    cv::Mat image1, image2;
-    cv::cvtColor(image01, image1, cv::COLOR_BGR2GRAY);
-    cv::cvtColor(image02, image2, cv::COLOR_BGR2GRAY);
-
-    cv::Ptr<cv::ORB> detector = cv::ORB::create(1000); // 增加特征点数量
-    std::vector<cv::KeyPoint> keypoints1, keypoints2;
-    cv::Mat descriptors1, descriptors2;
-    detector->detectAndCompute(image1, cv::noArray(), keypoints1, descriptors1);
-    detector->detectAndCompute(image2, cv::noArray(), keypoints2, descriptors2);
-
-    // 检查是否检测到足够的特征点
-    if (keypoints1.size() < 10 || keypoints2.size() < 10) {
-        throw std::runtime_error("检测到的特征点数量不足（图像1: " + std::to_string(keypoints1.size()) + 
-                                ", 图像2: " + std::to_string(keypoints2.size()) + "），无法进行匹配");
-    }
-
-    // 使用BFMatcher替代FlannBasedMatcher，避免FLANN兼容性问题
-    cv::BFMatcher matcher(cv::NORM_HAMMING);
-    std::vector<std::vector<cv::DMatch>> matches;
-    std::vector<cv::DMatch> goodMatches;
-    matcher.knnMatch(descriptors1, descriptors2, matches, 2);
-
-    for (size_t i = 0; i < matches.size(); i++)
-    {
-        if (matches[i][0].distance < 0.6 * matches[i][1].distance) // 放宽匹配条件
-            goodMatches.push_back(matches[i][0]);
-    }
-
-    // 检查是否有足够的良好匹配
-    if (goodMatches.size() < 4) {
-        // 如果还是不够，尝试更宽松的条件
-        goodMatches.clear();
-        for (size_t i = 0; i < matches.size(); i++)
-        {
-            if (matches[i][0].distance < 0.8 * matches[i][1].distance)
-                goodMatches.push_back(matches[i][0]);
-        }
-        
-        if (goodMatches.size() < 4) {
-            throw std::runtime_error("良好匹配的特征点数量不足（需要至少4个，当前只有" + std::to_string(goodMatches.size()) + "个）");
-        }
-    }
-
-    std::vector<cv::Point2f> pts1, pts2;
-    for (auto &m : goodMatches)
-    {
-        pts1.push_back(keypoints1[m.queryIdx].pt);
-        pts2.push_back(keypoints2[m.trainIdx].pt);
-    }
-
-    cv::Mat H = cv::findHomography(pts1, pts2, cv::RANSAC);
-    if (H.empty()) {
-        // 如果无法计算单应性矩阵，尝试使用简单的平移拼接
-        std::cout << "警告：无法计算单应性矩阵，使用简单平移拼接" << std::endl;
-        
-        // 计算简单的平移
-        cv::Point2f center1(0, 0), center2(0, 0);
-        for (const auto& pt : pts1) center1 += pt;
-        for (const auto& pt : pts2) center2 += pt;
-        center1 *= 1.0f / pts1.size();
-        center2 *= 1.0f / pts2.size();
-        
-        cv::Point2f translation = center2 - center1;
-        
-        // 创建简单的平移矩阵
-        H = cv::Mat::eye(3, 3, CV_64F);
-        H.at<double>(0, 2) = translation.x;
-        H.at<double>(1, 2) = translation.y;
-    }
-    
-    CalcCorners(H, image01);
-    
-    // 计算变换后图像的边界
-    float min_x = std::min({corners.left_top.x, corners.left_bottom.x, 0.0f});
-    float max_x = std::max({corners.right_top.x, corners.right_bottom.x, (float)image02.cols});
-    float min_y = std::min({corners.left_top.y, corners.right_top.y, 0.0f});
-    float max_y = std::max({corners.left_bottom.y, corners.right_bottom.y, (float)image02.rows});
-    
-    // 确保边界为正数
-    int dst_width = std::max(1, (int)(max_x - min_x));
-    int dst_height = std::max(1, (int)(max_y - min_y));
-    
-    // 创建变换矩阵，包含平移
-    cv::Mat H_translated = cv::Mat::eye(3, 3, CV_64F);
-    H_translated.at<double>(0, 2) = -min_x;
-    H_translated.at<double>(1, 2) = -min_y;
-    cv::Mat H_final = H_translated * H;
-    
-    cv::Mat imageTransform1;
-    cv::warpPerspective(image01, imageTransform1, H_final, cv::Size(dst_width, dst_height));
-    
-    cv::Mat dst(dst_height, dst_width, CV_8UC3);
-    dst.setTo(0);
-    
-    // 先复制变换后的第一张图像
-    cv::Rect roi1(0, 0, std::min(imageTransform1.cols, dst.cols), std::min(imageTransform1.rows, dst.rows));
-    imageTransform1(roi1).copyTo(dst(roi1));
-    
-    // 计算第二张图像在dst中的位置
-    int x_offset = (int)(-min_x);
-    int y_offset = (int)(-min_y);
-    
-    // 确保偏移量在合理范围内
-    x_offset = std::max(0, std::min(x_offset, dst.cols - 1));
-    y_offset = std::max(0, std::min(y_offset, dst.rows - 1));
-    
-    // 计算第二张图像的有效区域
-    int img2_width = std::min(image02.cols, dst.cols - x_offset);
-    int img2_height = std::min(image02.rows, dst.rows - y_offset);
-    
-    if (img2_width > 0 && img2_height > 0) {
-        cv::Rect roi2(x_offset, y_offset, img2_width, img2_height);
-        cv::Rect roi2_src(0, 0, img2_width, img2_height);
-        image02(roi2_src).copyTo(dst(roi2));
-    }
-    
-    // 更新角点坐标以匹配新的坐标系
-    corners.left_top.x -= min_x;
-    corners.left_top.y -= min_y;
-    corners.left_bottom.x -= min_x;
-    corners.left_bottom.y -= min_y;
-    corners.right_top.x -= min_x;
-    corners.right_top.y -= min_y;
-    corners.right_bottom.x -= min_x;
-    corners.right_bottom.y -= min_y;
-    
-    // 改进的混合逻辑：检查重叠区域并正确混合
-    for (int y = 0; y < dst.rows; y++) {
-        for (int x = 0; x < dst.cols; x++) {
-            cv::Vec3b& pixel = dst.at<cv::Vec3b>(y, x);
-            
-            // 检查是否在第二张图像的有效区域内
-            bool in_img2 = (x >= x_offset && x < x_offset + image02.cols && 
-                           y >= y_offset && y < y_offset + image02.rows);
-            
-            // 检查是否在变换后的第一张图像的有效区域内
-            bool in_img1 = false;
-            if (x < imageTransform1.cols && y < imageTransform1.rows) {
-                cv::Vec3b trans_pixel = imageTransform1.at<cv::Vec3b>(y, x);
-                in_img1 = (trans_pixel[0] != 0 || trans_pixel[1] != 0 || trans_pixel[2] != 0);
-            }
-            
-            // 如果在重叠区域，进行混合
-            if (in_img1 && in_img2) {
-                cv::Vec3b pixel1 = imageTransform1.at<cv::Vec3b>(y, x);
-                cv::Vec3b pixel2 = image02.at<cv::Vec3b>(y - y_offset, x - x_offset);
-                
-                // 使用距离权重进行混合
-                float dist_from_left = (float)(x - x_offset) / image02.cols;
-                float weight = std::max(0.0f, std::min(1.0f, dist_from_left));
-                
-                pixel[0] = (uchar)(pixel1[0] * (1 - weight) + pixel2[0] * weight);
-                pixel[1] = (uchar)(pixel1[1] * (1 - weight) + pixel2[1] * weight);
-                pixel[2] = (uchar)(pixel1[2] * (1 - weight) + pixel2[2] * weight);
-            }
-            // 如果只在第一张图像中
-            else if (in_img1) {
-                pixel = imageTransform1.at<cv::Vec3b>(y, x);
-            }
-            // 如果只在第二张图像中
-            else if (in_img2) {
-                pixel = image02.at<cv::Vec3b>(y - y_offset, x - x_offset);
-            }
-        }
-    }
-    cv::imwrite(output, dst);
-
-    double end_time = omp_get_wtime();
-    return end_time - start_time;
-}
-
-// 串行版本的灰度转换函数
-double convert_to_grayscale_serial_py(const std::string &input, const std::string &output)
-{
-    FILE *in = NULL, *out = NULL;
-    in = fopen(input.c_str(), "rb");
-    if (!in)
-    {
-        throw std::runtime_error("无法打开输入文件: " + input);
-    }
-    out = fopen(output.c_str(), "wb");
-    if (!out)
-    {
-        fclose(in);
-        throw std::runtime_error("无法创建输出文件: " + output);
-    }
-
-    fileHeader *fh = (fileHeader *)malloc(sizeof(fileHeader));
-    fileInfo *fi = (fileInfo *)malloc(sizeof(fileInfo));
-    fread(fh, sizeof(fileHeader), 1, in);
-    fread(fi, sizeof(fileInfo), 1, in);
-
-    double start_time, end_time;
-    start_time = omp_get_wtime();
-    int width = fi->biWidth, height = fi->biHeight;
-    int rowSize = ((width * 3 + 3) / 4) * 4;
-
-    // 初始化新的文件头
-    fileHeader newFh;
-    fileInfo newFi;
-    
-    // 复制文件头信息
-    memcpy(&newFh, fh, sizeof(fileHeader));
-    memcpy(&newFi, fi, sizeof(fileInfo));
-    
-    // 设置新的参数
-    newFi.biBitCount = 8;
-    newFi.biCompression = 0;
-    newFi.biSizeImage = ((width + 3) / 4) * 4 * height;
-    newFi.biPlanes = 1;
-    newFi.biClrUsed = 256;
-    newFi.biClrImportant = 256;
-    
-    newFh.bfOffBits = sizeof(fileHeader) + sizeof(fileInfo) + 256 * sizeof(rgbq);
-    newFh.bfSize = newFh.bfOffBits + newFi.biSizeImage;
-
-    rgbq *palette = (rgbq *)malloc(256 * sizeof(rgbq));
-    for (int i = 0; i < 256; i++)
-    {
-        palette[i].rgbRed = palette[i].rgbGreen = palette[i].rgbBlue = i;
-        palette[i].rgbReserved = 0;
-    }
-
-    fwrite(&newFh, sizeof(fileHeader), 1, out);
-    fwrite(&newFi, sizeof(fileInfo), 1, out);
-    fwrite(palette, sizeof(rgbq), 256, out);
-
-    unsigned char *rgbRow = (unsigned char *)malloc(rowSize);
-    unsigned char *grayRow = (unsigned char *)calloc(((width + 3) / 4) * 4, 1);
-    unsigned char *grayData = (unsigned char *)malloc(((width + 3) / 4) * 4 * height);
-
-    // 读取所有行并转换为灰度
-    // BMP格式的图像数据可能是从下到上存储的，需要检查biHeight的符号
-    bool bottom_up = (fi->biHeight > 0);
-    int actual_height = abs(fi->biHeight);
-    
-    if (bottom_up) {
-        // 图像数据从下到上存储，需要从后往前读取
-        for (int i = actual_height - 1; i >= 0; i--)
-        {
-            fread(rgbRow, 1, rowSize, in);
-            for (int j = 0; j < width; j++)
-            {
-                int b = rgbRow[j * 3];
-                int g = rgbRow[j * 3 + 1];
-                int r = rgbRow[j * 3 + 2];
-                grayData[i * ((width + 3) / 4) * 4 + j] = (r + g + b) / 3;
-            }
-        }
-    } else {
-        // 图像数据从上到下存储，正常读取
-        for (int i = 0; i < actual_height; i++)
-        {
-            fread(rgbRow, 1, rowSize, in);
-            for (int j = 0; j < width; j++)
-            {
-                int b = rgbRow[j * 3];
-                int g = rgbRow[j * 3 + 1];
-                int r = rgbRow[j * 3 + 2];
-                grayData[i * ((width + 3) / 4) * 4 + j] = (r + g + b) / 3;
-            }
-        }
-    }
-
-    // BMP文件要求图像数据从下到上存储
-    for (int i = height - 1; i >= 0; i--)
-    {
-        memcpy(grayRow, grayData + i * ((width + 3) / 4) * 4, ((width + 3) / 4) * 4);
-        fwrite(grayRow, 1, ((width + 3) / 4) * 4, out);
-    }
-    end_time = omp_get_wtime();
-    double elapsed_time = end_time - start_time;
-
-    free(fh);
-    free(fi);
-    free(palette);
-    free(rgbRow);
-    free(grayRow);
-    free(grayData);
-    fclose(in);
-    fclose(out);
-
-    return elapsed_time;
-}
-
-// 串行版本的二值化函数
-double convert_to_binary_serial_py(const std::string &input, const std::string &output, int threshold)
-{
-    double start_time, end_time;
-    start_time = omp_get_wtime();
-    
-    FILE *in = NULL, *out = NULL;
-    in = fopen(input.c_str(), "rb");
-    if (!in)
-    {
-        throw std::runtime_error("无法打开输入文件: " + input);
-    }
-    out = fopen(output.c_str(), "wb");
-    if (!out)
-    {
-        fclose(in);
-        throw std::runtime_error("无法创建输出文件: " + output);
-    }
-
-    fileHeader *fh = (fileHeader *)malloc(sizeof(fileHeader));
-    fileInfo *fi = (fileInfo *)malloc(sizeof(fileInfo));
-    fread(fh, sizeof(fileHeader), 1, in);
-    fread(fi, sizeof(fileInfo), 1, in);
-
-    int width = fi->biWidth, height = fi->biHeight;
-    int rowSize = ((width * 3 + 3) / 4) * 4;
-
-    // 初始化新的文件头
-    fileHeader newFh;
-    fileInfo newFi;
-    
-    // 复制文件头信息
-    memcpy(&newFh, fh, sizeof(fileHeader));
-    memcpy(&newFi, fi, sizeof(fileInfo));
-    
-    // 设置新的参数
-    newFi.biBitCount = 8;
-    newFi.biCompression = 0;
-    newFi.biSizeImage = ((width + 3) / 4) * 4 * height;
-    newFi.biPlanes = 1;
-    newFi.biClrUsed = 256;
-    newFi.biClrImportant = 256;
-    
-    newFh.bfOffBits = sizeof(fileHeader) + sizeof(fileInfo) + 256 * sizeof(rgbq);
-    newFh.bfSize = newFh.bfOffBits + newFi.biSizeImage;
-
-    rgbq *palette = (rgbq *)malloc(256 * sizeof(rgbq));
-    for (int i = 0; i < 256; i++)
-    {
-        palette[i].rgbRed = palette[i].rgbGreen = palette[i].rgbBlue = i;
-        palette[i].rgbReserved = 0;
-    }
-
-    fwrite(&newFh, sizeof(fileHeader), 1, out);
-    fwrite(&newFi, sizeof(fileInfo), 1, out);
-    fwrite(palette, sizeof(rgbq), 256, out);
-
-    unsigned char *rgbRow = (unsigned char *)malloc(rowSize);
-    unsigned char *binRow = (unsigned char *)calloc(((width + 3) / 4) * 4, 1);
-    unsigned char *binData = (unsigned char *)malloc(((width + 3) / 4) * 4 * height);
-
-    // 读取所有行并转换为二值图
-    // BMP格式的图像数据可能是从下到上存储的，需要检查biHeight的符号
-    bool bottom_up = (fi->biHeight > 0);
-    int actual_height = abs(fi->biHeight);
-    
-    if (bottom_up) {
-        // 图像数据从下到上存储，需要从后往前读取
-        for (int i = actual_height - 1; i >= 0; i--)
-        {
-            fread(rgbRow, 1, rowSize, in);
-            for (int j = 0; j < width; j++)
-            {
-                int b = rgbRow[j * 3];
-                int g = rgbRow[j * 3 + 1];
-                int r = rgbRow[j * 3 + 2];
-                int gray = (r + g + b) / 3;
-                binData[i * ((width + 3) / 4) * 4 + j] = (gray >= threshold) ? 255 : 0;
-            }
-        }
-    } else {
-        // 图像数据从上到下存储，正常读取
-        for (int i = 0; i < actual_height; i++)
-        {
-            fread(rgbRow, 1, rowSize, in);
-            for (int j = 0; j < width; j++)
-            {
-                int b = rgbRow[j * 3];
-                int g = rgbRow[j * 3 + 1];
-                int r = rgbRow[j * 3 + 2];
-                int gray = (r + g + b) / 3;
-                binData[i * ((width + 3) / 4) * 4 + j] = (gray >= threshold) ? 255 : 0;
-            }
-        }
-    }
-
-    // BMP文件要求图像数据从下到上存储
-    for (int i = height - 1; i >= 0; i--)
-    {
-        memcpy(binRow, binData + i * ((width + 3) / 4) * 4, ((width + 3) / 4) * 4);
-        fwrite(binRow, 1, ((width + 3) / 4) * 4, out);
-    }
-
-    free(fh);
-    free(fi);
-    free(palette);
-    free(rgbRow);
-    free(binRow);
-    free(binData);
-    fclose(in);
-    fclose(out);
-    
-    end_time = omp_get_wtime();
-    return end_time - start_time;
-}
-
-// 串行版本的亮度调整函数
-double adjust_brightness_serial_py(const std::string &input, const std::string &output, int delta)
-{
-    double start_time, end_time;
-    start_time = omp_get_wtime();
-    
-    FILE *in = NULL, *out = NULL;
-    in = fopen(input.c_str(), "rb");
-    if (!in)
-    {
-        throw std::runtime_error("无法打开输入文件: " + input);
-    }
-    out = fopen(output.c_str(), "wb");
-    if (!out)
-    {
-        fclose(in);
-        throw std::runtime_error("无法创建输出文件: " + output);
-    }
-
-    fileHeader fh;
-    fileInfo fi;
-    fread(&fh, sizeof(fileHeader), 1, in);
-    fread(&fi, sizeof(fileInfo), 1, in);
-
-    if (fi.biBitCount != 24)
-    {
-        fclose(in);
-        fclose(out);
-        throw std::runtime_error("仅支持24位RGB图像亮度调整");
-    }
-
-    int width = fi.biWidth, height = fi.biHeight;
-    int rowSize = ((width * 3 + 3) / 4) * 4;
-
-    fwrite(&fh, sizeof(fileHeader), 1, out);
-    fwrite(&fi, sizeof(fileInfo), 1, out);
-
-    unsigned char *row = (unsigned char *)malloc(rowSize);
-    unsigned char *imageData = (unsigned char *)malloc(rowSize * height);
-
-    // 读取所有行
-    // BMP格式的图像数据可能是从下到上存储的，需要检查biHeight的符号
-    bool bottom_up = (fi.biHeight > 0);
-    int actual_height = abs(fi.biHeight);
-    
-    if (bottom_up) {
-        // 图像数据从下到上存储，需要从后往前读取
-        for (int i = actual_height - 1; i >= 0; i--)
-        {
-            fread(row, 1, rowSize, in);
-            memcpy(imageData + i * rowSize, row, rowSize);
-        }
-    } else {
-        // 图像数据从上到下存储，正常读取
-        for (int i = 0; i < actual_height; i++)
-        {
-            fread(row, 1, rowSize, in);
-            memcpy(imageData + i * rowSize, row, rowSize);
-        }
-    }
-
-    // 处理图像数据
-    for (int i = 0; i < height; i++)
-    {
-        for (int j = 0; j < width; j++)
-        {
-            unsigned char *pixel = imageData + i * rowSize + j * 3;
-            pixel[0] = clamp(pixel[0] + delta);
-            pixel[1] = clamp(pixel[1] + delta);
-            pixel[2] = clamp(pixel[2] + delta);
-        }
-    }
-
-    // BMP文件要求图像数据从下到上存储
-    for (int i = height - 1; i >= 0; i--)
-    {
-        memcpy(row, imageData + i * rowSize, rowSize);
-        fwrite(row, 1, rowSize, out);
-    }
-
-    free(row);
-    free(imageData);
-    fclose(in);
-    fclose(out);
-    
-    end_time = omp_get_wtime();
-    return end_time - start_time;
-}
-
-// 串行版本的高斯核生成函数
-void generate_gaussian_kernel_serial(float **kernel, int size, float sigma)
-{
-    int half = size / 2;
-    float sum = 0.0f;
-
-    for (int i = -half; i <= half; i++)
-    {
-        for (int j = -half; j <= half; j++)
-        {
-            float value = expf(-(i * i + j * j) / (2 * sigma * sigma));
-            kernel[i + half][j + half] = value;
-            sum += value;
-        }
-    }
-
-    for (int i = 0; i < size; i++)
-    {
-        for (int j = 0; j < size; j++)
-        {
-            kernel[i][j] /= sum;
-        }
-    }
-}
-
-// 串行版本的高斯模糊函数
-double apply_gaussian_blur_serial_py(const std::string &input, const std::string &output, int kernel_size, float sigma)
-{
-    double start_time, end_time;
-    start_time = omp_get_wtime();
-    
-    FILE *in = NULL, *out = NULL;
-    in = fopen(input.c_str(), "rb");
-    if (!in)
-    {
-        throw std::runtime_error("无法打开输入文件: " + input);
-    }
-    out = fopen(output.c_str(), "wb");
-    if (!out)
-    {
-        fclose(in);
-        throw std::runtime_error("无法创建输出文件: " + output);
-    }
-
-    fileHeader fh;
-    fileInfo fi;
-    fread(&fh, sizeof(fileHeader), 1, in);
-    fread(&fi, sizeof(fileInfo), 1, in);
-
-    if (fi.biBitCount != 24)
-    {
-        fclose(in);
-        fclose(out);
-        throw std::runtime_error("仅支持24位RGB图像进行高斯模糊");
-    }
-
-    int width = fi.biWidth, height = fi.biHeight;
-    int rowSize = ((width * 3 + 3) / 4) * 4;
-
-    fwrite(&fh, sizeof(fileHeader), 1, out);
-    fwrite(&fi, sizeof(fileInfo), 1, out);
-
-    unsigned char *src = (unsigned char *)malloc(rowSize * height);
-    unsigned char *dst = (unsigned char *)malloc(rowSize * height);
-    
-    // BMP格式的图像数据可能是从下到上存储的，需要检查biHeight的符号
-    bool bottom_up = (fi.biHeight > 0);
-    int actual_height = abs(fi.biHeight);
-    
-    if (bottom_up) {
-        // 图像数据从下到上存储，需要从后往前读取
-        for (int i = actual_height - 1; i >= 0; i--)
-        {
-            fread(src + i * rowSize, 1, rowSize, in);
-        }
-    } else {
-        // 图像数据从上到下存储，正常读取
-        for (int i = 0; i < actual_height; i++)
-        {
-            fread(src + i * rowSize, 1, rowSize, in);
-        }
-    }
-
-    // 动态分配卷积核内存
-    float **kernel = (float **)malloc(kernel_size * sizeof(float *));
-    for (int i = 0; i < kernel_size; i++) {
-        kernel[i] = (float *)malloc(kernel_size * sizeof(float));
-    }
-    
-    generate_gaussian_kernel_serial(kernel, kernel_size, sigma);
-    int half = kernel_size / 2;
-
-    for (int y = 0; y < height; y++)
-    {
-        for (int x = 0; x < width; x++)
-        {
-            float sumB = 0, sumG = 0, sumR = 0;
-            for (int i = -half; i <= half; i++)
-            {
-                for (int j = -half; j <= half; j++)
-                {
-                    int ny = y + i;
-                    int nx = x + j;
-                    if (nx < 0)
-                        nx = 0;
-                    if (ny < 0)
-                        ny = 0;
-                    if (nx >= width)
-                        nx = width - 1;
-                    if (ny >= height)
-                        ny = height - 1;
-                    unsigned char *p = src + ny * rowSize + nx * 3;
-                    float weight = kernel[i + half][j + half];
-                    sumB += p[0] * weight;
-                    sumG += p[1] * weight;
-                    sumR += p[2] * weight;
-                }
-            }
-            unsigned char *outPix = dst + y * rowSize + x * 3;
-            outPix[0] = clamp((int)(sumB + 0.5));
-            outPix[1] = clamp((int)(sumG + 0.5));
-            outPix[2] = clamp((int)(sumR + 0.5));
-        }
-    }
-
-    // BMP文件要求图像数据从下到上存储
-    for (int i = height - 1; i >= 0; i--)
-    {
-        fwrite(dst + i * rowSize, 1, rowSize, out);
-    }
-
-    // 释放卷积核内存
-    for (int i = 0; i < kernel_size; i++) {
-        free(kernel[i]);
-    }
-    free(kernel);
-    
-    free(src);
-    free(dst);
-    fclose(in);
-    fclose(out);
-    
-    end_time = omp_get_wtime();
-    return end_time - start_time;
-}
-
-// 串行版本的自定义卷积函数
-double apply_custom_convolution_serial_py(const std::string &input, const std::string &output,
-                                         const std::vector<std::vector<int>> &kernel_vec, float divisor)
-{
-    double start_time, end_time;
-    start_time = omp_get_wtime();
-    
-    FILE *in = NULL, *out = NULL;
-    in = fopen(input.c_str(), "rb");
-    if (!in)
-    {
-        throw std::runtime_error("无法打开输入文件: " + input);
-    }
-    out = fopen(output.c_str(), "wb");
-    if (!out)
-    {
-        fclose(in);
-        throw std::runtime_error("无法创建输出文件: " + output);
-    }
-
-    fileHeader fh;
-    fileInfo fi;
-    fread(&fh, sizeof(fileHeader), 1, in);
-    fread(&fi, sizeof(fileInfo), 1, in);
-
-    if (fi.biBitCount != 24)
-    {
-        fclose(in);
-        fclose(out);
-        throw std::runtime_error("仅支持24位RGB图像进行卷积操作");
-    }
-
-    int width = fi.biWidth, height = fi.biHeight;
-    int rowSize = ((width * 3 + 3) / 4) * 4;
-
-    fwrite(&fh, sizeof(fileHeader), 1, out);
-    fwrite(&fi, sizeof(fileInfo), 1, out);
-
-    unsigned char *src = (unsigned char *)malloc(rowSize * height);
-    unsigned char *dst = (unsigned char *)malloc(rowSize * height);
-    
-    // BMP格式的图像数据可能是从下到上存储的，需要检查biHeight的符号
-    bool bottom_up = (fi.biHeight > 0);
-    int actual_height = abs(fi.biHeight);
-    
-    if (bottom_up) {
-        // 图像数据从下到上存储，需要从后往前读取
-        for (int i = actual_height - 1; i >= 0; i--)
-        {
-            fread(src + i * rowSize, 1, rowSize, in);
-        }
-    } else {
-        // 图像数据从上到下存储，正常读取
-        for (int i = 0; i < actual_height; i++)
-        {
-            fread(src + i * rowSize, 1, rowSize, in);
-        }
-    }
-    memset(dst, 0, rowSize * height);
-
-    // 将vector转换为数组
-    int kernel[3][3];
-    for (int i = 0; i < 3; i++)
-    {
-        for (int j = 0; j < 3; j++)
-        {
-            kernel[i][j] = kernel_vec[i][j];
-        }
-    }
-
-    for (int y = 1; y < height - 1; y++)
-    {
-        for (int x = 1; x < width - 1; x++)
-        {
-            int sumR = 0, sumG = 0, sumB = 0;
-            for (int i = -1; i <= 1; i++)
-            {
-                for (int j = -1; j <= 1; j++)
-                {
-                    int ny = y + i;
-                    int nx = x + j;
-                    unsigned char *p = src + ny * rowSize + nx * 3;
-                    sumB += p[0] * kernel[i + 1][j + 1];
-                    sumG += p[1] * kernel[i + 1][j + 1];
-                    sumR += p[2] * kernel[i + 1][j + 1];
-                }
-            }
-            unsigned char *outPix = dst + y * rowSize + x * 3;
-            outPix[0] = clamp(sumB / divisor);
-            outPix[1] = clamp(sumG / divisor);
-            outPix[2] = clamp(sumR / divisor);
-        }
-    }
-
-    // BMP文件要求图像数据从下到上存储
-    for (int i = height - 1; i >= 0; i--)
-    {
-        fwrite(dst + i * rowSize, 1, rowSize, out);
-    }
-    free(src);
-    free(dst);
-    fclose(in);
-    fclose(out);
-    
-    end_time = omp_get_wtime();
-    return end_time - start_time;
-}
-
-// 串行版本的Sobel边缘检测函数
-double apply_sobel_edge_detection_serial_py(const std::string &input, const std::string &output)
-{
-    double start_time, end_time;
-    start_time = omp_get_wtime();
-    
-    FILE *in = NULL, *out = NULL;
-    in = fopen(input.c_str(), "rb");
-    if (!in)
-    {
-        throw std::runtime_error("无法打开输入文件: " + input);
-    }
-    out = fopen(output.c_str(), "wb");
-    if (!out)
-    {
-        fclose(in);
-        throw std::runtime_error("无法创建输出文件: " + output);
-    }
-
-    fileHeader fh;
-    fileInfo fi;
-    fread(&fh, sizeof(fileHeader), 1, in);
-    fread(&fi, sizeof(fileInfo), 1, in);
-
-    if (fi.biBitCount != 24)
-    {
-        fclose(in);
-        fclose(out);
-        throw std::runtime_error("仅支持24位RGB图像进行Sobel边缘检测");
-    }
-
-    int width = fi.biWidth, height = fi.biHeight;
-    int rowSize = ((width * 3 + 3) / 4) * 4;
-
-    fwrite(&fh, sizeof(fileHeader), 1, out);
-    fwrite(&fi, sizeof(fileInfo), 1, out);
-
-    unsigned char *src = (unsigned char *)malloc(rowSize * height);
-    unsigned char *dst = (unsigned char *)malloc(rowSize * height);
-    
-    // BMP格式的图像数据可能是从下到上存储的，需要检查biHeight的符号
-    bool bottom_up = (fi.biHeight > 0);
-    int actual_height = abs(fi.biHeight);
-    
-    if (bottom_up) {
-        // 图像数据从下到上存储，需要从后往前读取
-        for (int i = actual_height - 1; i >= 0; i--)
-        {
-            fread(src + i * rowSize, 1, rowSize, in);
-        }
-    } else {
-        // 图像数据从上到下存储，正常读取
-        for (int i = 0; i < actual_height; i++)
-        {
-            fread(src + i * rowSize, 1, rowSize, in);
-        }
-    }
-    memset(dst, 0, rowSize * height);
-
-    int Gx[3][3] = {
-        {-1, 0, 1},
-        {-2, 0, 2},
-        {-1, 0, 1}};
-
-    int Gy[3][3] = {
-        {-1, -2, -1},
-        {0, 0, 0},
-        {1, 2, 1}};
-
-    for (int y = 1; y < height - 1; y++)
-    {
-        for (int x = 1; x < width - 1; x++)
-        {
-            int gx = 0, gy = 0;
-            for (int i = -1; i <= 1; i++)
-            {
-                for (int j = -1; j <= 1; j++)
-                {
-                    int ny = y + i;
-                    int nx = x + j;
-                    unsigned char *p = src + ny * rowSize + nx * 3;
-                    int gray = (p[0] + p[1] + p[2]) / 3;
-                    gx += gray * Gx[i + 1][j + 1];
-                    gy += gray * Gy[i + 1][j + 1];
-                }
-            }
-            int magnitude = (int)sqrt(gx * gx + gy * gy);
-            unsigned char edge = clamp(magnitude);
-            unsigned char *outPix = dst + y * rowSize + x * 3;
-            outPix[0] = outPix[1] = outPix[2] = edge;
-        }
-    }
-
-    // BMP文件要求图像数据从下到上存储
-    for (int i = height - 1; i >= 0; i--)
-    {
-        fwrite(dst + i * rowSize, 1, rowSize, out);
-    }
-
-    free(src);
-    free(dst);
-    fclose(in);
-    fclose(out);
-    
-    end_time = omp_get_wtime();
-    return end_time - start_time;
-}
-
-// 全局变量存储当前设置的线程数
-static int current_omp_threads = omp_get_max_threads();
-
-// 设置OpenMP线程数的函数
-void set_omp_threads(int num_threads)
-{
-    omp_set_num_threads(num_threads);
-    current_omp_threads = num_threads;
-}
-
-// 获取OpenMP线程数的函数
-int get_omp_threads()
-{
-    return current_omp_threads;
-}
-
-// pybind11模块定义
-PYBIND11_MODULE(image_processing, m)
-{
-    m.doc() = "OpenMP加速的图像处理模块"; // 模块文档字符串
-
-    // 设置OpenMP线程数
-    m.def("set_omp_threads", &set_omp_threads, "设置OpenMP线程数",
-          py::arg("num_threads"));
-
-    // 获取OpenMP线程数
-    m.def("get_omp_threads", &get_omp_threads, "获取OpenMP最大线程数");
-
-    // RGB转灰度图
-    m.def("convert_to_grayscale", &convert_to_grayscale_py,
-          "将RGB图像转换为灰度图",
-          py::arg("input"), py::arg("output"));
-
-    // RGB转二值图
-    m.def("convert_to_binary", &convert_to_binary_py,
-          "将RGB图像转换为二值图",
-          py::arg("input"), py::arg("output"), py::arg("threshold"));
-
-    // 亮度调整
-    m.def("adjust_brightness", &adjust_brightness_py,
-          "调整图像亮度",
-          py::arg("input"), py::arg("output"), py::arg("delta"));
-
-    // 高斯模糊
-    m.def("apply_gaussian_blur", &apply_gaussian_blur_py,
-          "应用高斯模糊",
-          py::arg("input"), py::arg("output"), py::arg("kernel_size"), py::arg("sigma"));
-
-    // 自定义卷积
-    m.def("apply_custom_convolution", &apply_custom_convolution_py,
-          "应用自定义卷积滤波器",
-          py::arg("input"), py::arg("output"), py::arg("kernel"), py::arg("divisor"));
-
-    // Sobel边缘检测
-    m.def("apply_sobel_edge_detection", &apply_sobel_edge_detection_py,
-          "应用Sobel边缘检测",
-          py::arg("input"), py::arg("output"));
-
-    // 图像拼接
-    m.def("stitch_images_surf", &stitch_images_surf_py,
-          "使用SURF特征进行图像拼接",
-          py::arg("input1"), py::arg("input2"), py::arg("output"));
-
-    // 串行版本的函数绑定
-    // 串行版本RGB转灰度图
-    m.def("convert_to_grayscale_serial", &convert_to_grayscale_serial_py,
-          "将RGB图像转换为灰度图（串行版本）",
-          py::arg("input"), py::arg("output"));
-
-    // 串行版本RGB转二值图
-    m.def("convert_to_binary_serial", &convert_to_binary_serial_py,
-          "将RGB图像转换为二值图（串行版本）",
-          py::arg("input"), py::arg("output"), py::arg("threshold"));
-
-    // 串行版本亮度调整
-    m.def("adjust_brightness_serial", &adjust_brightness_serial_py,
-          "调整图像亮度（串行版本）",
-          py::arg("input"), py::arg("output"), py::arg("delta"));
-
-    // 串行版本高斯模糊
-    m.def("apply_gaussian_blur_serial", &apply_gaussian_blur_serial_py,
-          "应用高斯模糊（串行版本）",
-          py::arg("input"), py::arg("output"), py::arg("kernel_size"), py::arg("sigma"));
-
-    // 串行版本自定义卷积
-    m.def("apply_custom_convolution_serial", &apply_custom_convolution_serial_py,
-          "应用自定义卷积滤波器（串行版本）",
-          py::arg("input"), py::arg("output"), py::arg("kernel"), py::arg("divisor"));
-
-    // 串行版本Sobel边缘检测
-    m.def("apply_sobel_edge_detection_serial", &apply_sobel_edge_detection_serial_py,
-          "应用Sobel边缘检测（串行版本）",
-          py::arg("input"), py::arg("output"));
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <pybind11/numpy.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <malloc.h>
+#include <opencv2/opencv.hpp>
+#include <opencv2/features2d.hpp>
+#include <time.h>
+#include <string>
+#include <stdint.h>
+#include <limits.h>
+#include <memory>
+#include <complex>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <atomic>
+#include <functional>
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+namespace py = pybind11;
+using namespace cv;
+
+#pragma pack(1)
+typedef struct
+{
+    unsigned char bfType[2];      // "BM"
+    uint32_t bfSize;              // 文件大小
+    uint16_t bfReserved1;         // 保留字段1
+    uint16_t bfReserved2;         // 保留字段2
+    uint32_t bfOffBits;           // 数据偏移量
+} fileHeader;
+
+typedef struct
+{
+    uint32_t biSize;              // 信息头大小
+    int32_t biWidth;              // 图像宽度
+    int32_t biHeight;             // 图像高度
+    uint16_t biPlanes;            // 平面数
+    uint16_t biBitCount;          // 每像素位数
+    uint32_t biCompression;       // 压缩类型
+    uint32_t biSizeImage;         // 图像数据大小
+    int32_t biXPixPerMeter;       // 水平分辨率
+    int32_t biYPixPerMeter;       // 垂直分辨率
+    uint32_t biClrUsed;           // 使用的颜色数
+    uint32_t biClrImportant;      // 重要颜色数
+} fileInfo;
+
+typedef struct
+{
+    unsigned char rgbBlue;
+    unsigned char rgbGreen;
+    unsigned char rgbRed;
+    unsigned char rgbReserved;
+} rgbq;
+#pragma pack()
+
+unsigned char clamp(int val)
+{
+    if (val < 0)
+        return 0;
+    if (val > 255)
+        return 255;
+    return (unsigned char)val;
+}
+
+// 图像视图：不拥有内存，只描述一块按行跨度排列的像素缓冲区。
+// 既可以包装从BMP读入的缓冲区，也可以直接包装NumPy数组，计算核心统一基于它实现。
+struct ImageView
+{
+    unsigned char *data; // 第0行（图像最上方一行）首地址
+    int width;
+    int height;
+    ptrdiff_t stride;    // 相邻两行之间的字节距离
+    int channels;        // 1表示灰度，3表示BGR
+
+    unsigned char *row(int y) const { return data + y * stride; }
+};
+
+// 生成归一化的一维高斯核，二维高斯核等于它与自身的外积
+std::vector<float> generate_gaussian_kernel_1d(int radius, float sigma)
+{
+    std::vector<float> kernel(2 * radius + 1);
+    float sum = 0.0f;
+    for (int i = -radius; i <= radius; i++)
+    {
+        float value = expf(-(i * i) / (2 * sigma * sigma));
+        kernel[i + radius] = value;
+        sum += value;
+    }
+    for (float &w : kernel)
+    {
+        w /= sum;
+    }
+    return kernel;
+}
+
+// ===================== SIMD点运算 =====================
+// 灰度、二值化、亮度调整都是访存受限的逐像素运算。这里按行提供标量/SSE4.2/AVX2/AVX-512
+// 四个版本：BGR交错数据用pshufb拆成三个通道平面，除以3改为定点乘法(x*21846)>>16
+// （对0..765内的整数与x/3完全一致），亮度调整用饱和加减，不再逐字节分支。
+// 256级查找表：AVX-512BW把表拆成16段、按高4位逐段pshufb；支持AVX-512VBMI时用vpermi2b
+// 一次查128项，两次查完整张表。SSE4.2/AVX2上16段pshufb比展开的标量查表还慢，仍用标量。
+// 具体使用哪个版本在模块加载时通过CPUID选定，同一个二进制可以在不同主机上运行；
+// 设置环境变量IMAGE_PROCESSING_ISA=scalar/sse4.2/avx2可以限制最高使用的指令集。
+
+struct PointOpsTable
+{
+    const char *isa;
+    void (*gray_row)(const unsigned char *bgr, unsigned char *gray, int width);
+    void (*binary_row)(const unsigned char *bgr, unsigned char *bin, int width, int threshold);
+    void (*brightness_row)(const unsigned char *src, unsigned char *dst, int bytes, int delta);
+    // 每个字节查同一张256级表，src与dst可以相同
+    void (*lut_row)(const unsigned char *src, unsigned char *dst, int bytes, const unsigned char *table);
+    // BGR交错数据，三个通道各查自己的表，src与dst可以相同
+    void (*lut3_row)(const unsigned char *bgr, unsigned char *dst, int width, const unsigned char (*tables)[256]);
+};
+
+static inline unsigned char gray_of(const unsigned char *p)
+{
+    return (unsigned char)(((p[0] + p[1] + p[2]) * 21846) >> 16);
+}
+
+static void gray_row_scalar(const unsigned char *s, unsigned char *d, int width)
+{
+    for (int j = 0; j < width; j++)
+        d[j] = gray_of(s + j * 3);
+}
+
+// threshold已限制在[0, 256]，256表示全部为0
+static void binary_row_scalar(const unsigned char *s, unsigned char *d, int width, int threshold)
+{
+    for (int j = 0; j < width; j++)
+        d[j] = (gray_of(s + j * 3) >= threshold) ? 255 : 0;
+}
+
+// delta已限制在[-255, 255]
+static void brightness_row_scalar(const unsigned char *s, unsigned char *d, int bytes, int delta)
+{
+    for (int j = 0; j < bytes; j++)
+    {
+        int v = s[j] + delta;
+        v = v < 0 ? 0 : v;
+        d[j] = (unsigned char)(v > 255 ? 255 : v);
+    }
+}
+
+// 每次先读出4个字节再写回：d与s、table都是unsigned char指针，逐字节写会迫使编译器在每次写之后重新读取
+static void lut_row_scalar(const unsigned char *s, unsigned char *d, int bytes, const unsigned char *table)
+{
+    int j = 0;
+    for (; j + 4 <= bytes; j += 4)
+    {
+        unsigned char v0 = table[s[j]], v1 = table[s[j + 1]], v2 = table[s[j + 2]], v3 = table[s[j + 3]];
+        d[j] = v0;
+        d[j + 1] = v1;
+        d[j + 2] = v2;
+        d[j + 3] = v3;
+    }
+    for (; j < bytes; j++)
+        d[j] = table[s[j]];
+}
+
+static void lut3_row_scalar(const unsigned char *s, unsigned char *d, int width, const unsigned char (*tables)[256])
+{
+    for (int j = 0; j < width * 3; j += 3)
+    {
+        unsigned char b = tables[0][s[j]], g = tables[1][s[j + 1]], r = tables[2][s[j + 2]];
+        d[j] = b;
+        d[j + 1] = g;
+        d[j + 2] = r;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// pshufb掩码：16个交错像素占3个16字节寄存器，bgr_shuffle[c][r]从第r个寄存器中取出通道c
+struct BgrShuffleMasks
+{
+    alignas(16) signed char m[3][3][16];
+};
+
+static BgrShuffleMasks make_bgr_shuffle_masks()
+{
+    BgrShuffleMasks masks;
+    for (int c = 0; c < 3; c++)
+        for (int r = 0; r < 3; r++)
+            for (int i = 0; i < 16; i++)
+            {
+                int pos = i * 3 + c - r * 16;
+                masks.m[c][r][i] = (pos >= 0 && pos < 16) ? (signed char)pos : (signed char)-1;
+            }
+    return masks;
+}
+
+static const BgrShuffleMasks bgr_shuffle = make_bgr_shuffle_masks();
+
+#define IP_MASK128(c, r) _mm_load_si128((const __m128i *)bgr_shuffle.m[c][r])
+
+// ---- SSE4.2：每次16个像素 ----
+__attribute__((target("sse4.2"))) static inline __m128i gray16_sse(const unsigned char *s)
+{
+    __m128i v0 = _mm_loadu_si128((const __m128i *)s);
+    __m128i v1 = _mm_loadu_si128((const __m128i *)(s + 16));
+    __m128i v2 = _mm_loadu_si128((const __m128i *)(s + 32));
+    __m128i b = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, IP_MASK128(0, 0)), _mm_shuffle_epi8(v1, IP_MASK128(0, 1))),
+                             _mm_shuffle_epi8(v2, IP_MASK128(0, 2)));
+    __m128i g = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, IP_MASK128(1, 0)), _mm_shuffle_epi8(v1, IP_MASK128(1, 1))),
+                             _mm_shuffle_epi8(v2, IP_MASK128(1, 2)));
+    __m128i r = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(v0, IP_MASK128(2, 0)), _mm_shuffle_epi8(v1, IP_MASK128(2, 1))),
+                             _mm_shuffle_epi8(v2, IP_MASK128(2, 2)));
+    __m128i zero = _mm_setzero_si128(), div3 = _mm_set1_epi16(21846);
+    __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(g, zero)), _mm_unpacklo_epi8(r, zero));
+    __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(g, zero)), _mm_unpackhi_epi8(r, zero));
+    return _mm_packus_epi16(_mm_mulhi_epu16(lo, div3), _mm_mulhi_epu16(hi, div3));
+}
+
+__attribute__((target("sse4.2"))) static void gray_row_sse(const unsigned char *s, unsigned char *d, int width)
+{
+    int j = 0;
+    for (; j + 16 <= width; j += 16)
+        _mm_storeu_si128((__m128i *)(d + j), gray16_sse(s + j * 3));
+    gray_row_scalar(s + j * 3, d + j, width - j);
+}
+
+__attribute__((target("sse4.2"))) static void binary_row_sse(const unsigned char *s, unsigned char *d, int width, int threshold)
+{
+    int j = 0;
+    if (threshold <= 255)
+    {
+        __m128i thr = _mm_set1_epi8((char)threshold);
+        for (; j + 16 <= width; j += 16)
+        {
+            __m128i gray = gray16_sse(s + j * 3);
+            _mm_storeu_si128((__m128i *)(d + j), _mm_cmpeq_epi8(_mm_max_epu8(gray, thr), gray));
+        }
+    }
+    binary_row_scalar(s + j * 3, d + j, width - j, threshold);
+}
+
+__attribute__((target("sse4.2"))) static void brightness_row_sse(const unsigned char *s, unsigned char *d, int bytes, int delta)
+{
+    int j = 0;
+    __m128i k = _mm_set1_epi8((char)abs(delta));
+    for (; j + 16 <= bytes; j += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + j));
+        v = (delta >= 0) ? _mm_adds_epu8(v, k) : _mm_subs_epu8(v, k);
+        _mm_storeu_si128((__m128i *)(d + j), v);
+    }
+    brightness_row_scalar(s + j, d + j, bytes - j, delta);
+}
+
+// ---- AVX2：每次32个像素，两个128位通道各处理16个像素（pshufb只在通道内重排） ----
+__attribute__((target("avx2"))) static inline __m256i load2x128(const unsigned char *a, const unsigned char *b)
+{
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)a)),
+                                   _mm_loadu_si128((const __m128i *)b), 1);
+}
+
+__attribute__((target("avx2"))) static inline __m256i gray32_avx2(const unsigned char *s)
+{
+    __m256i v0 = load2x128(s, s + 48);
+    __m256i v1 = load2x128(s + 16, s + 64);
+    __m256i v2 = load2x128(s + 32, s + 80);
+    __m256i ch[3];
+    for (int c = 0; c < 3; c++)
+    {
+        ch[c] = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(v0, _mm256_broadcastsi128_si256(IP_MASK128(c, 0))),
+                                                _mm256_shuffle_epi8(v1, _mm256_broadcastsi128_si256(IP_MASK128(c, 1)))),
+                                _mm256_shuffle_epi8(v2, _mm256_broadcastsi128_si256(IP_MASK128(c, 2))));
+    }
+    __m256i zero = _mm256_setzero_si256(), div3 = _mm256_set1_epi16(21846);
+    __m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(ch[0], zero), _mm256_unpacklo_epi8(ch[1], zero)),
+                                  _mm256_unpacklo_epi8(ch[2], zero));
+    __m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(ch[0], zero), _mm256_unpackhi_epi8(ch[1], zero)),
+                                  _mm256_unpackhi_epi8(ch[2], zero));
+    return _mm256_packus_epi16(_mm256_mulhi_epu16(lo, div3), _mm256_mulhi_epu16(hi, div3));
+}
+
+__attribute__((target("avx2"))) static void gray_row_avx2(const unsigned char *s, unsigned char *d, int width)
+{
+    int j = 0;
+    for (; j + 32 <= width; j += 32)
+        _mm256_storeu_si256((__m256i *)(d + j), gray32_avx2(s + j * 3));
+    gray_row_sse(s + j * 3, d + j, width - j);
+}
+
+__attribute__((target("avx2"))) static void binary_row_avx2(const unsigned char *s, unsigned char *d, int width, int threshold)
+{
+    int j = 0;
+    if (threshold <= 255)
+    {
+        __m256i thr = _mm256_set1_epi8((char)threshold);
+        for (; j + 32 <= width; j += 32)
+        {
+            __m256i gray = gray32_avx2(s + j * 3);
+            _mm256_storeu_si256((__m256i *)(d + j), _mm256_cmpeq_epi8(_mm256_max_epu8(gray, thr), gray));
+        }
+    }
+    binary_row_sse(s + j * 3, d + j, width - j, threshold);
+}
+
+__attribute__((target("avx2"))) static void brightness_row_avx2(const unsigned char *s, unsigned char *d, int bytes, int delta)
+{
+    int j = 0;
+    __m256i k = _mm256_set1_epi8((char)abs(delta));
+    for (; j + 32 <= bytes; j += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + j));
+        v = (delta >= 0) ? _mm256_adds_epu8(v, k) : _mm256_subs_epu8(v, k);
+        _mm256_storeu_si256((__m256i *)(d + j), v);
+    }
+    brightness_row_sse(s + j, d + j, bytes - j, delta);
+}
+
+// ---- AVX-512BW：每次64个像素，四个128位通道各处理16个像素 ----
+__attribute__((target("avx512f,avx512bw"))) static inline __m512i load4x128(const unsigned char *s)
+{
+    __m512i v = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i *)s));
+    v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i *)(s + 48)), 1);
+    v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i *)(s + 96)), 2);
+    return _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i *)(s + 144)), 3);
+}
+
+__attribute__((target("avx512f,avx512bw"))) static inline __m512i gray64_avx512(const unsigned char *s)
+{
+    __m512i v0 = load4x128(s);
+    __m512i v1 = load4x128(s + 16);
+    __m512i v2 = load4x128(s + 32);
+    __m512i ch[3];
+    for (int c = 0; c < 3; c++)
+    {
+        ch[c] = _mm512_or_si512(_mm512_or_si512(_mm512_shuffle_epi8(v0, _mm512_broadcast_i32x4(IP_MASK128(c, 0))),
+                                                _mm512_shuffle_epi8(v1, _mm512_broadcast_i32x4(IP_MASK128(c, 1)))),
+                                _mm512_shuffle_epi8(v2, _mm512_broadcast_i32x4(IP_MASK128(c, 2))));
+    }
+    __m512i zero = _mm512_setzero_si512(), div3 = _mm512_set1_epi16(21846);
+    __m512i lo = _mm512_add_epi16(_mm512_add_epi16(_mm512_unpacklo_epi8(ch[0], zero), _mm512_unpacklo_epi8(ch[1], zero)),
+                                  _mm512_unpacklo_epi8(ch[2], zero));
+    __m512i hi = _mm512_add_epi16(_mm512_add_epi16(_mm512_unpackhi_epi8(ch[0], zero), _mm512_unpackhi_epi8(ch[1], zero)),
+                                  _mm512_unpackhi_epi8(ch[2], zero));
+    return _mm512_packus_epi16(_mm512_mulhi_epu16(lo, div3), _mm512_mulhi_epu16(hi, div3));
+}
+
+__attribute__((target("avx512f,avx512bw"))) static void gray_row_avx512(const unsigned char *s, unsigned char *d, int width)
+{
+    int j = 0;
+    for (; j + 64 <= width; j += 64)
+        _mm512_storeu_si512((void *)(d + j), gray64_avx512(s + j * 3));
+    gray_row_avx2(s + j * 3, d + j, width - j);
+}
+
+__attribute__((target("avx512f,avx512bw"))) static void binary_row_avx512(const unsigned char *s, unsigned char *d, int width, int threshold)
+{
+    int j = 0;
+    if (threshold <= 255)
+    {
+        __m512i thr = _mm512_set1_epi8((char)threshold);
+        for (; j + 64 <= width; j += 64)
+        {
+            __mmask64 m = _mm512_cmpge_epu8_mask(gray64_avx512(s + j * 3), thr);
+            _mm512_storeu_si512((void *)(d + j), _mm512_movm_epi8(m));
+        }
+    }
+    binary_row_avx2(s + j * 3, d + j, width - j, threshold);
+}
+
+__attribute__((target("avx512f,avx512bw"))) static void brightness_row_avx512(const unsigned char *s, unsigned char *d, int bytes, int delta)
+{
+    int j = 0;
+    __m512i k = _mm512_set1_epi8((char)abs(delta));
+    for (; j + 64 <= bytes; j += 64)
+    {
+        __m512i v = _mm512_loadu_si512((const void *)(s + j));
+        v = (delta >= 0) ? _mm512_adds_epu8(v, k) : _mm512_subs_epu8(v, k);
+        _mm512_storeu_si512((void *)(d + j), v);
+    }
+    brightness_row_avx2(s + j, d + j, bytes - j, delta);
+}
+
+// 第h段（表项16h..16h+15）只对高4位为h的字节生效：x^(h<<4)后这些字节小于16，饱和加0x70后最高位为0、
+// 低4位不变，pshufb取出对应表项；其他字节加0x70后最高位为1，pshufb输出0，16段的结果按位或起来即可
+__attribute__((target("avx512f,avx512bw"))) static void lut_row_avx512(const unsigned char *s, unsigned char *d,
+                                                                      int bytes, const unsigned char *table)
+{
+    int j = 0;
+    __m512i bias = _mm512_set1_epi8(0x70);
+    for (; j + 64 <= bytes; j += 64)
+    {
+        __m512i x = _mm512_loadu_si512((const void *)(s + j));
+        __m512i r = _mm512_setzero_si512();
+        for (int h = 0; h < 16; h++)
+        {
+            __m512i t = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)(table + 16 * h)));
+            __m512i idx = _mm512_adds_epu8(_mm512_xor_si512(x, _mm512_set1_epi8((char)(h << 4))), bias);
+            r = _mm512_or_si512(r, _mm512_shuffle_epi8(t, idx));
+        }
+        _mm512_storeu_si512((void *)(d + j), r);
+    }
+    lut_row_scalar(s + j, d + j, bytes - j, table);
+}
+
+// ---- AVX-512VBMI：vpermi2b按低7位在两个寄存器（128项）中查表，再按最高位在前后两半之间选择 ----
+__attribute__((target("avx512f,avx512bw,avx512vbmi"))) static inline __m512i lut64_vbmi(__m512i x, const __m512i *t)
+{
+    __m512i lo = _mm512_permutex2var_epi8(t[0], x, t[1]);
+    __m512i hi = _mm512_permutex2var_epi8(t[2], x, t[3]);
+    return _mm512_mask_blend_epi8(_mm512_movepi8_mask(x), lo, hi);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vbmi"))) static void lut_row_vbmi(const unsigned char *s, unsigned char *d,
+                                                                                int bytes, const unsigned char *table)
+{
+    __m512i t[4];
+    for (int k = 0; k < 4; k++)
+        t[k] = _mm512_loadu_si512((const void *)(table + 64 * k));
+    int j = 0;
+    for (; j + 64 <= bytes; j += 64)
+        _mm512_storeu_si512((void *)(d + j), lut64_vbmi(_mm512_loadu_si512((const void *)(s + j)), t));
+    lut_row_scalar(s + j, d + j, bytes - j, table);
+}
+
+// 64个像素（192字节）一组，分三个寄存器；第p个寄存器中第i个字节属于通道(p + i) % 3
+__attribute__((target("avx512f,avx512bw,avx512vbmi"))) static void lut3_row_vbmi(const unsigned char *s, unsigned char *d,
+                                                                                 int width,
+                                                                                 const unsigned char (*tables)[256])
+{
+    __m512i t[3][4];
+    for (int c = 0; c < 3; c++)
+        for (int k = 0; k < 4; k++)
+            t[c][k] = _mm512_loadu_si512((const void *)(tables[c] + 64 * k));
+    __mmask64 masks[3][3] = {};
+    for (int p = 0; p < 3; p++)
+        for (int i = 0; i < 64; i++)
+            masks[p][(p + i) % 3] |= (__mmask64)1 << i;
+
+    int j = 0;
+    for (; j + 64 <= width; j += 64)
+    {
+        for (int p = 0; p < 3; p++)
+        {
+            size_t o = (size_t)j * 3 + 64 * p;
+            __m512i x = _mm512_loadu_si512((const void *)(s + o));
+            __m512i r = lut64_vbmi(x, t[0]);
+            r = _mm512_mask_mov_epi8(r, masks[p][1], lut64_vbmi(x, t[1]));
+            r = _mm512_mask_mov_epi8(r, masks[p][2], lut64_vbmi(x, t[2]));
+            _mm512_storeu_si512((void *)(d + o), r);
+        }
+    }
+    lut3_row_scalar(s + j * 3, d + j * 3, width - j, tables);
+}
+
+#undef IP_MASK128
+#endif
+
+// 根据CPU支持的指令集（以及IMAGE_PROCESSING_ISA环境变量给出的上限）选择实现
+// IMAGE_PROCESSING_ISA允许的最高指令集级别：0标量，1 SSE4.2，2 AVX2，3 AVX-512
+static int isa_level_limit()
+{
+    const char *env = getenv("IMAGE_PROCESSING_ISA");
+    std::string limit = env ? env : "";
+    if (limit == "scalar")
+        return 0;
+    if (limit == "sse4.2")
+        return 1;
+    if (limit == "avx2")
+        return 2;
+    return 3;
+}
+
+static PointOpsTable select_point_ops()
+{
+    PointOpsTable table = {"scalar", gray_row_scalar, binary_row_scalar, brightness_row_scalar,
+                           lut_row_scalar, lut3_row_scalar};
+#if defined(__x86_64__) || defined(__i386__)
+    int maxLevel = isa_level_limit();
+    __builtin_cpu_init();
+    if (maxLevel >= 3 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    {
+        table = {"avx512", gray_row_avx512, binary_row_avx512, brightness_row_avx512,
+                 lut_row_avx512, lut3_row_scalar};
+        if (__builtin_cpu_supports("avx512vbmi"))
+        {
+            table.lut_row = lut_row_vbmi;
+            table.lut3_row = lut3_row_vbmi;
+        }
+    }
+    else if (maxLevel >= 2 && __builtin_cpu_supports("avx2"))
+        table = {"avx2", gray_row_avx2, binary_row_avx2, brightness_row_avx2, lut_row_scalar, lut3_row_scalar};
+    else if (maxLevel >= 1 && __builtin_cpu_supports("sse4.2"))
+        table = {"sse4.2", gray_row_sse, binary_row_sse, brightness_row_sse, lut_row_scalar, lut3_row_scalar};
+#endif
+    return table;
+}
+
+static const PointOpsTable point_ops = select_point_ops();
+
+// 返回当前使用的指令集名称
+std::string get_simd_isa()
+{
+    return point_ops.isa;
+}
+
+// ===================== 执行策略 =====================
+// 每个计算核心只写一份，可并行的循环交给模板参数Policy执行，串行与并行版本编译自同一份代码：
+//   SerialPolicy      在调用线程上顺序执行，不进入并行区域（*_serial接口）
+//   OmpStaticPolicy   schedule(static)，迭代按编号均分给各线程
+//   OmpDynamicPolicy  schedule(dynamic)，线程做完一块再领下一块
+//   OmpTaskPolicy     一个线程用taskloop把迭代切成任务，整个线程组从任务队列中取任务执行
+//   OmpRuntimePolicy  schedule(runtime)，调度方式由执行上下文或OMP_SCHEDULE决定，都未指定时为static，是默认策略
+// Policy::for_each(n, init, body)对i = 0..n-1调用body(local, i)，local是每个参与的线程用init()构造的
+// 私有工作区（中间缓冲等），只构造一次、在该线程的所有迭代间复用；不需要工作区时用parallel_for
+
+struct SerialPolicy
+{
+    static int concurrency() { return 1; }
+
+    template <typename Init, typename Body>
+    static void for_each(int n, Init init, Body body)
+    {
+        auto local = init();
+        for (int i = 0; i < n; i++)
+            body(local, i);
+    }
+};
+
+struct OmpStaticPolicy
+{
+    static int concurrency() { return omp_get_max_threads(); }
+
+    template <typename Init, typename Body>
+    static void for_each(int n, Init init, Body body)
+    {
+#pragma omp parallel
+        {
+            auto local = init();
+#pragma omp for schedule(static)
+            for (int i = 0; i < n; i++)
+                body(local, i);
+        }
+    }
+};
+
+struct OmpDynamicPolicy
+{
+    static int concurrency() { return omp_get_max_threads(); }
+
+    template <typename Init, typename Body>
+    static void for_each(int n, Init init, Body body)
+    {
+#pragma omp parallel
+        {
+            auto local = init();
+#pragma omp for schedule(dynamic)
+            for (int i = 0; i < n; i++)
+                body(local, i);
+        }
+    }
+};
+
+struct OmpTaskPolicy
+{
+    static int concurrency() { return omp_get_max_threads(); }
+
+    // 任务是绑定（tied）的，一个任务从头到尾在同一线程上执行，可以按线程号取该线程的工作区。
+    // 每个线程约4个任务，既能让先做完的线程接走别人的任务，又不至于让任务调度开销盖过计算
+    template <typename Init, typename Body>
+    static void for_each(int n, Init init, Body body)
+    {
+        typedef decltype(init()) Local;
+        if (n <= 0)
+            return;
+        std::vector<Local *> locals(omp_get_max_threads());
+#pragma omp parallel
+        {
+            Local local = init();
+            locals[omp_get_thread_num()] = &local;
+            int tasks = std::min(n, 4 * omp_get_num_threads());
+#pragma omp barrier
+#pragma omp single
+            {
+#pragma omp taskloop num_tasks(tasks)
+                for (int i = 0; i < n; i++)
+                    body(*locals[omp_get_thread_num()], i);
+            }
+        }
+    }
+};
+
+struct OmpRuntimePolicy
+{
+    static int concurrency() { return omp_get_max_threads(); }
+
+    template <typename Init, typename Body>
+    static void for_each(int n, Init init, Body body)
+    {
+#pragma omp parallel
+        {
+            auto local = init();
+#pragma omp for schedule(runtime)
+            for (int i = 0; i < n; i++)
+                body(local, i);
+        }
+    }
+};
+
+// 不需要线程私有工作区的循环
+template <typename Policy, typename Body>
+inline void parallel_for(int n, Body body)
+{
+    Policy::for_each(n, [] { return 0; }, [&](int, int i) { body(i); });
+}
+
+// 灰度转换核心：src为1或3通道，dst为单通道
+template <typename Policy = OmpRuntimePolicy>
+void grayscale_kernel(const ImageView &src, const ImageView &dst)
+{
+    parallel_for<Policy>(src.height, [&](int i) {
+        if (src.channels == 1)
+            memcpy(dst.row(i), src.row(i), src.width);
+        else
+            point_ops.gray_row(src.row(i), dst.row(i), src.width);
+    });
+}
+
+// 二值化核心：src为1或3通道，dst为单通道
+template <typename Policy = OmpRuntimePolicy>
+void binary_kernel(const ImageView &src, const ImageView &dst, int threshold)
+{
+    threshold = std::min(std::max(threshold, 0), 256);
+    parallel_for<Policy>(src.height, [&](int i) {
+        const unsigned char *s = src.row(i);
+        unsigned char *d = dst.row(i);
+        if (src.channels == 1)
+        {
+            for (int j = 0; j < src.width; j++)
+                d[j] = (s[j] >= threshold) ? 255 : 0;
+        }
+        else
+        {
+            point_ops.binary_row(s, d, src.width, threshold);
+        }
+    });
+}
+
+// 亮度调整核心：逐字节饱和加delta，src与dst可以是同一缓冲区
+template <typename Policy = OmpRuntimePolicy>
+void brightness_kernel(const ImageView &src, const ImageView &dst, int delta)
+{
+    delta = std::min(std::max(delta, -255), 255);
+    int rowBytes = src.width * src.channels;
+    parallel_for<Policy>(src.height, [&](int i) {
+        point_ops.brightness_row(src.row(i), dst.row(i), rowBytes, delta);
+    });
+}
+
+// ===================== 查找表点运算 =====================
+// 亮度、对比度、gamma、色阶、曲线等色调调整都是逐字节的映射，先对0..255算出每个通道的查找表，
+// 再用SIMD查表一遍写出。多个调整依次复合进同一张表，无论串了多少个都只扫一遍图像，
+// 结果与逐个调整、每步都截断到0..255后再做下一步完全一致。
+
+// 查找表：table[0..2]依次用于B、G、R通道，table[3]用于单通道图像（只受作用于全部通道的调整影响）
+struct PointLut
+{
+    alignas(64) unsigned char table[4][256];
+
+    PointLut()
+    {
+        for (int c = 0; c < 4; c++)
+            for (int v = 0; v < 256; v++)
+                table[c][v] = (unsigned char)v;
+    }
+
+    // 三个颜色通道是否使用同一张表
+    bool uniform() const
+    {
+        return memcmp(table[0], table[1], 256) == 0 && memcmp(table[0], table[2], 256) == 0;
+    }
+
+    // 在现有映射之后接上v -> f(v)，结果四舍五入并截断到[0, 255]；channel为-1时作用于全部通道
+    template <typename F>
+    void then(int channel, F f)
+    {
+        unsigned char map[256];
+        for (int v = 0; v < 256; v++)
+            map[v] = clamp((int)lround(f((double)v)));
+        for (int c = 0; c < 4; c++)
+        {
+            if (channel >= 0 && c != channel)
+                continue;
+            for (int v = 0; v < 256; v++)
+                table[c][v] = map[table[c][v]];
+        }
+    }
+};
+
+// 查找表核心：dst与src通道数相同，src与dst可以是同一缓冲区（原地修改）
+template <typename Policy = OmpRuntimePolicy>
+void lut_kernel(const ImageView &src, const ImageView &dst, const PointLut &lut)
+{
+    int rowBytes = src.width * src.channels;
+    if (src.channels == 1 || lut.uniform())
+    {
+        const unsigned char *table = lut.table[src.channels == 1 ? 3 : 0];
+        parallel_for<Policy>(src.height, [&](int i) { point_ops.lut_row(src.row(i), dst.row(i), rowBytes, table); });
+    }
+    else
+    {
+        parallel_for<Policy>(src.height, [&](int i) { point_ops.lut3_row(src.row(i), dst.row(i), src.width, lut.table); });
+    }
+}
+
+// ===================== 自动阈值二值化 =====================
+// 输入只读一遍：每个线程把负责的行转成灰度写进输出，同时累加自己私有的256级直方图，
+// 结束后合并直方图、选出阈值，再在单通道的输出上原地分级。第二遍只访问输出平面（输入的三分之一）。
+// 阈值的含义与binary_kernel相同：亮度>=t的像素属于更高一类
+
+// 阈值选择方法
+enum ThresholdMethod
+{
+    THRESHOLD_OTSU,     // 类间方差最大；classes大于2时为多级Otsu
+    THRESHOLD_TRIANGLE  // 三角法，适合一个主峰加长尾的直方图
+};
+
+ThresholdMethod parse_threshold_method(const std::string &method)
+{
+    if (method == "otsu")
+        return THRESHOLD_OTSU;
+    if (method == "triangle")
+        return THRESHOLD_TRIANGLE;
+    throw std::runtime_error("未知的阈值方法: " + method + "（可选otsu、triangle）");
+}
+
+static const int AUTO_THRESHOLD_MAX_CLASSES = 8;
+
+struct AutoThresholdResult
+{
+    std::vector<int> thresholds;      // classes-1个递增的阈值
+    std::vector<long long> histogram; // 256级亮度直方图
+};
+
+// 一行灰度的直方图累加到h（4组256级计数）。相邻像素轮流计入不同的组，
+// 连续相同灰度的像素不会反复读改写同一个计数器而互相等待
+static inline void histogram_row(const unsigned char *g, int n, uint32_t *h)
+{
+    int j = 0;
+    for (; j + 4 <= n; j += 4)
+    {
+        h[g[j]]++;
+        h[256 + g[j + 1]]++;
+        h[512 + g[j + 2]]++;
+        h[768 + g[j + 3]]++;
+    }
+    for (; j < n; j++)
+        h[g[j]]++;
+}
+
+// 灰度写入dst并返回整幅图的直方图；每个线程一份私有计数，最后串行合并，循环中没有原子操作
+template <typename Policy>
+std::vector<long long> gray_histogram(const ImageView &src, const ImageView &dst)
+{
+    std::deque<std::vector<uint32_t>> partial;
+    std::mutex partialMutex;
+    auto init = [&] {
+        std::lock_guard<std::mutex> lock(partialMutex);
+        partial.emplace_back(4 * 256, 0);
+        return partial.back().data();
+    };
+    Policy::for_each(src.height, init, [&](uint32_t *h, int i) {
+        unsigned char *d = dst.row(i);
+        if (src.channels == 1)
+            memcpy(d, src.row(i), src.width);
+        else
+            point_ops.gray_row(src.row(i), d, src.width);
+        histogram_row(d, src.width, h);
+    });
+
+    std::vector<long long> histogram(256, 0);
+    for (const std::vector<uint32_t> &h : partial)
+        for (int k = 0; k < 4 * 256; k++)
+            histogram[k & 255] += h[k];
+    return histogram;
+}
+
+// Otsu：把0..255切成classes段，使各段的类间方差之和最大。类间方差等于sum(m_k^2 / w_k) - N * mu^2，
+// w_k与m_k为第k段的像素数与灰度和，用前缀和O(1)求出；按段数动态规划，classes=2时即经典Otsu
+std::vector<int> otsu_thresholds(const std::vector<long long> &histogram, int classes)
+{
+    std::vector<double> w(257, 0.0), m(257, 0.0);
+    for (int i = 0; i < 256; i++)
+    {
+        w[i + 1] = w[i] + histogram[i];
+        m[i + 1] = m[i] + (double)i * histogram[i];
+    }
+    auto score = [&](int a, int b) {
+        double n = w[b] - w[a], s = m[b] - m[a];
+        return n > 0 ? s * s / n : 0.0;
+    };
+
+    // best[k][b]：把[0, b)切成k+1段的最大得分，from[k][b]为最后一段的起点
+    std::vector<std::vector<double>> best(classes, std::vector<double>(257, -1.0));
+    std::vector<std::vector<int>> from(classes, std::vector<int>(257, 0));
+    for (int b = 1; b <= 256; b++)
+        best[0][b] = score(0, b);
+    for (int k = 1; k < classes; k++)
+    {
+        for (int b = k + 1; b <= 256; b++)
+        {
+            for (int a = k; a < b; a++)
+            {
+                double v = best[k - 1][a] + score(a, b);
+                if (v > best[k][b])
+                {
+                    best[k][b] = v;
+                    from[k][b] = a;
+                }
+            }
+        }
+    }
+
+    std::vector<int> thresholds(classes - 1);
+    for (int k = classes - 1, b = 256; k > 0; k--)
+    {
+        b = from[k][b];
+        thresholds[k - 1] = b;
+    }
+    return thresholds;
+}
+
+// 三角法（Zack）：从直方图峰顶向较长一侧的尾端连一条直线，取离直线最远的灰度级，与OpenCV的THRESH_TRIANGLE一致
+int triangle_threshold(const std::vector<long long> &histogram)
+{
+    std::vector<long long> h(histogram);
+    int left = 0, right = 255, peak = 0;
+    while (left < 255 && h[left] == 0)
+        left++;
+    if (left > 0)
+        left--;
+    while (right > 0 && h[right] == 0)
+        right--;
+    if (right < 255)
+        right++;
+    for (int i = 1; i < 256; i++)
+        if (h[i] > h[peak])
+            peak = i;
+
+    // 尾巴在峰的右侧时翻转直方图，统一按左侧处理
+    bool flipped = false;
+    if (peak - left < right - peak)
+    {
+        std::reverse(h.begin(), h.end());
+        left = 255 - right;
+        peak = 255 - peak;
+        flipped = true;
+    }
+
+    // 点(i, h[i])到直线的距离与a * i + b * h[i]成正比（省去常数项与分母）
+    int t = left;
+    double a = (double)h[peak], b = left - peak, dist = 0;
+    for (int i = left + 1; i <= peak; i++)
+    {
+        double d = a * i + b * h[i];
+        if (d > dist)
+        {
+            dist = d;
+            t = i;
+        }
+    }
+    t--;
+    if (flipped)
+        t = 255 - t;
+    // OpenCV中大于t的像素为前景，换成>=的含义
+    return t + 1;
+}
+
+// 自动阈值二值化核心：src为1或3通道，dst为单通道。classes为2时输出0/255，
+// 多级Otsu时第k类（从0开始）输出round(k * 255 / (classes - 1))
+template <typename Policy = OmpRuntimePolicy>
+AutoThresholdResult auto_binary_kernel(const ImageView &src, const ImageView &dst, ThresholdMethod method,
+                                       int classes)
+{
+    if (classes < 2 || classes > AUTO_THRESHOLD_MAX_CLASSES)
+    {
+        throw std::runtime_error("classes必须在2到" + std::to_string(AUTO_THRESHOLD_MAX_CLASSES) + "之间");
+    }
+    if (method == THRESHOLD_TRIANGLE && classes != 2)
+    {
+        throw std::runtime_error("三角法只支持classes=2");
+    }
+
+    AutoThresholdResult result;
+    result.histogram = gray_histogram<Policy>(src, dst);
+    if (method == THRESHOLD_TRIANGLE)
+        result.thresholds.push_back(triangle_threshold(result.histogram));
+    else
+        result.thresholds = otsu_thresholds(result.histogram, classes);
+
+    if (classes == 2)
+    {
+        unsigned char t = (unsigned char)std::min(result.thresholds[0], 255);
+        bool none = result.thresholds[0] > 255;
+        parallel_for<Policy>(dst.height, [&](int i) {
+            unsigned char *d = dst.row(i);
+            for (int j = 0; j < dst.width; j++)
+                d[j] = (!none && d[j] >= t) ? 255 : 0;
+        });
+        return result;
+    }
+
+    alignas(64) unsigned char lut[256];
+    for (int v = 0, k = 0; v < 256; v++)
+    {
+        while (k < classes - 1 && v >= result.thresholds[k])
+            k++;
+        lut[v] = (unsigned char)((k * 255 + (classes - 1) / 2) / (classes - 1));
+    }
+    parallel_for<Policy>(dst.height, [&](int i) { point_ops.lut_row(dst.row(i), dst.row(i), dst.width, lut); });
+    return result;
+}
+
+// 高斯模糊的实现方式
+enum GaussianMethod
+{
+    GAUSSIAN_AUTO,      // 根据kernel_size与sigma自动选择
+    GAUSSIAN_SEPARABLE, // 先水平后垂直的两遍一维卷积，每像素O(k)
+    GAUSSIAN_RECURSIVE  // Young–van Vliet递归（IIR）近似，每像素O(1)，与核大小无关
+};
+
+GaussianMethod parse_gaussian_method(const std::string &method)
+{
+    if (method == "auto")
+        return GAUSSIAN_AUTO;
+    if (method == "separable")
+        return GAUSSIAN_SEPARABLE;
+    if (method == "recursive")
+        return GAUSSIAN_RECURSIVE;
+    throw std::runtime_error("未知的高斯模糊方式: " + method);
+}
+
+// 有效半径：超过4σ的权重小于峰值的e^-8，可以直接截掉
+int gaussian_effective_radius(int kernel_size, float sigma)
+{
+    return std::min(kernel_size / 2, (int)ceilf(4.0f * sigma));
+}
+
+// 自动选择：核足够大、且核覆盖了±3σ（截断可以忽略，递归近似与用户要求的核一致）时使用递归模式
+GaussianMethod choose_gaussian_method(int kernel_size, float sigma)
+{
+    int radius = gaussian_effective_radius(kernel_size, sigma);
+    if (radius >= 12 && kernel_size / 2 >= 3.0f * sigma)
+        return GAUSSIAN_RECURSIVE;
+    return GAUSSIAN_SEPARABLE;
+}
+
+// 可分离高斯模糊：输出行切成每线程一段的连续行块，
+// 用(2r+1)行的环形缓冲保存水平卷积结果，垂直卷积直接在环形缓冲上进行，不需要整幅中间图像
+template <typename Policy>
+void gaussian_blur_separable(const ImageView &src, const ImageView &dst, int radius, float sigma)
+{
+    int width = src.width, height = src.height, cn = src.channels;
+    int rowLen = width * cn;
+    int window = 2 * radius + 1;
+    std::vector<float> kernel = generate_gaussian_kernel_1d(radius, sigma);
+    const float *w = kernel.data();
+
+    // 每块开头要先补算2r行水平卷积才能填满环形缓冲，所以块数与线程数相同，不再细分
+    struct Buffers
+    {
+        std::vector<float> padded, ring, acc;
+    };
+    int chunks = std::max(1, std::min(Policy::concurrency(), height));
+    auto init = [&] {
+        Buffers b;
+        b.padded.resize((size_t)(width + 2 * radius) * cn);
+        b.ring.resize((size_t)window * rowLen);
+        b.acc.resize(rowLen);
+        return b;
+    };
+
+    Policy::for_each(chunks, init, [&](Buffers &b, int chunk) {
+        int y0 = (int)((long long)height * chunk / chunks);
+        int y1 = (int)((long long)height * (chunk + 1) / chunks);
+        std::vector<float> &padded = b.padded, &ring = b.ring, &acc = b.acc;
+
+        // 计算第sy行（越界时复制边缘行）的水平卷积，存入环形缓冲
+        auto horizontal = [&](int sy) {
+            const unsigned char *s = src.row(std::min(std::max(sy, 0), height - 1));
+            for (int x = -radius; x < width + radius; x++)
+            {
+                int nx = std::min(std::max(x, 0), width - 1);
+                for (int c = 0; c < cn; c++)
+                    padded[(x + radius) * cn + c] = s[nx * cn + c];
+            }
+            float *h = &ring[(size_t)((sy + window * 2) % window) * rowLen];
+            std::fill(h, h + rowLen, 0.0f);
+            for (int k = 0; k < window; k++)
+            {
+                const float *p = &padded[k * cn];
+                float wk = w[k];
+#pragma omp simd
+                for (int i = 0; i < rowLen; i++)
+                    h[i] += wk * p[i];
+            }
+        };
+
+        if (y0 < y1)
+        {
+            for (int sy = y0 - radius; sy < y0 + radius; sy++)
+                horizontal(sy);
+        }
+        for (int y = y0; y < y1; y++)
+        {
+            horizontal(y + radius);
+            std::fill(acc.begin(), acc.end(), 0.0f);
+            for (int k = 0; k < window; k++)
+            {
+                const float *h = &ring[(size_t)((y - radius + k + window * 2) % window) * rowLen];
+                float wk = w[k];
+#pragma omp simd
+                for (int i = 0; i < rowLen; i++)
+                    acc[i] += wk * h[i];
+            }
+            unsigned char *d = dst.row(y);
+            for (int i = 0; i < rowLen; i++)
+                d[i] = clamp((int)(acc[i] + 0.5f));
+        }
+    });
+}
+
+// Young–van Vliet递归高斯的系数。
+// M用于右端边界：把正向递推结束时的状态映射为反向递推的初始状态，
+// 等价于输入在末端之后无限复制最后一个像素（Triggs–Sdika边界条件）
+struct RecursiveGaussianCoeffs
+{
+    float B, a1, a2, a3;
+    float M[3][3];
+};
+
+RecursiveGaussianCoeffs recursive_gaussian_coeffs(float sigma)
+{
+    double q = (sigma >= 2.5f) ? 0.98711 * sigma - 0.96330
+                               : 3.97156 - 4.14554 * sqrt(1.0 - 0.26891 * sigma);
+    double q2 = q * q, q3 = q2 * q;
+    double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+    double b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+    double b2 = -(1.4281 * q2 + 1.26661 * q3);
+    double b3 = 0.422205 * q3;
+    RecursiveGaussianCoeffs k;
+    k.a1 = (float)(b1 / b0);
+    k.a2 = (float)(b2 / b0);
+    k.a3 = (float)(b3 / b0);
+    k.B = 1.0f - (k.a1 + k.a2 + k.a3);
+
+    // 数值求M：正向状态取单位向量、之后输入为0，递推足够长后再反向递推回来
+    double a1 = b1 / b0, a2 = b2 / b0, a3 = b3 / b0, B = 1.0 - (a1 + a2 + a3);
+    int tailLen = 64 + (int)(20.0 * sigma);
+    std::vector<double> tail(tailLen);
+    for (int j = 0; j < 3; j++)
+    {
+        double w1 = (j == 0), w2 = (j == 1), w3 = (j == 2);
+        for (int n = 0; n < tailLen; n++)
+        {
+            double v = a1 * w1 + a2 * w2 + a3 * w3;
+            tail[n] = v;
+            w3 = w2;
+            w2 = w1;
+            w1 = v;
+        }
+        double v1 = 0, v2 = 0, v3 = 0;
+        for (int n = tailLen - 1; n >= 0; n--)
+        {
+            double v = B * tail[n] + a1 * v1 + a2 * v2 + a3 * v3;
+            v3 = v2;
+            v2 = v1;
+            v1 = v;
+        }
+        k.M[0][j] = (float)v1;
+        k.M[1][j] = (float)v2;
+        k.M[2][j] = (float)v3;
+    }
+    return k;
+}
+
+// 由正向递推的末状态(w1,w2,w3)与末端像素值u求反向递推的初始状态
+inline void recursive_gaussian_tail(const RecursiveGaussianCoeffs &k, float u,
+                                    float w1, float w2, float w3, float &v1, float &v2, float &v3)
+{
+    float d1 = w1 - u, d2 = w2 - u, d3 = w3 - u;
+    v1 = u + k.M[0][0] * d1 + k.M[0][1] * d2 + k.M[0][2] * d3;
+    v2 = u + k.M[1][0] * d1 + k.M[1][1] * d2 + k.M[1][2] * d3;
+    v3 = u + k.M[2][0] * d1 + k.M[2][1] * d2 + k.M[2][2] * d3;
+}
+
+// 递归高斯模糊：水平方向逐行做正反两遍IIR；垂直方向按列块并行，每次处理一整段连续内存。
+// 两端边界都相当于无限复制边缘像素
+template <typename Policy>
+void gaussian_blur_recursive(const ImageView &src, const ImageView &dst, float sigma)
+{
+    int width = src.width, height = src.height, cn = src.channels;
+    size_t rowLen = (size_t)width * cn;
+    RecursiveGaussianCoeffs k = recursive_gaussian_coeffs(std::max(sigma, 0.5f));
+    std::vector<float> tmp(rowLen * height);
+
+    // 水平方向
+    parallel_for<Policy>(height, [&](int y) {
+        const unsigned char *s = src.row(y);
+        float *t = &tmp[(size_t)y * rowLen];
+        for (int c = 0; c < cn; c++)
+        {
+            float w1 = s[c], w2 = w1, w3 = w1;
+            for (int x = 0; x < width; x++)
+            {
+                float v = k.B * s[x * cn + c] + k.a1 * w1 + k.a2 * w2 + k.a3 * w3;
+                t[x * cn + c] = v;
+                w3 = w2;
+                w2 = w1;
+                w1 = v;
+            }
+            float u = s[(width - 1) * cn + c];
+            recursive_gaussian_tail(k, u, w1, w2, w3, w1, w2, w3);
+            for (int x = width - 1; x >= 0; x--)
+            {
+                float v = k.B * t[x * cn + c] + k.a1 * w1 + k.a2 * w2 + k.a3 * w3;
+                t[x * cn + c] = v;
+                w3 = w2;
+                w2 = w1;
+                w1 = v;
+            }
+        }
+    });
+
+    // 垂直方向：每个列块内逐行递推，内层循环在一行的连续元素上向量化
+    const int blockLen = 256;
+    int blocks = (int)((rowLen + blockLen - 1) / blockLen);
+    parallel_for<Policy>(blocks, [&](int b) {
+        size_t i0 = (size_t)b * blockLen;
+        int len = (int)std::min((size_t)blockLen, rowLen - i0);
+        float w1[blockLen], w2[blockLen], w3[blockLen], u[blockLen];
+
+        const float *first = &tmp[i0];
+        const float *last = &tmp[(size_t)(height - 1) * rowLen + i0];
+        for (int i = 0; i < len; i++)
+            u[i] = last[i];
+        for (int i = 0; i < len; i++)
+            w1[i] = w2[i] = w3[i] = first[i];
+        for (int y = 0; y < height; y++)
+        {
+            float *t = &tmp[(size_t)y * rowLen + i0];
+#pragma omp simd
+            for (int i = 0; i < len; i++)
+            {
+                float v = k.B * t[i] + k.a1 * w1[i] + k.a2 * w2[i] + k.a3 * w3[i];
+                t[i] = v;
+                w3[i] = w2[i];
+                w2[i] = w1[i];
+                w1[i] = v;
+            }
+        }
+
+        for (int i = 0; i < len; i++)
+            recursive_gaussian_tail(k, u[i], w1[i], w2[i], w3[i], w1[i], w2[i], w3[i]);
+        for (int y = height - 1; y >= 0; y--)
+        {
+            float *t = &tmp[(size_t)y * rowLen + i0];
+            unsigned char *d = dst.row(y) + i0;
+#pragma omp simd
+            for (int i = 0; i < len; i++)
+            {
+                float v = k.B * t[i] + k.a1 * w1[i] + k.a2 * w2[i] + k.a3 * w3[i];
+                w3[i] = w2[i];
+                w2[i] = w1[i];
+                w1[i] = v;
+            }
+            for (int i = 0; i < len; i++)
+                d[i] = clamp((int)(w1[i] + 0.5f));
+        }
+    });
+}
+
+// 高斯模糊核心：边界按复制最近像素处理，src与dst通道数相同且不能重叠
+template <typename Policy = OmpRuntimePolicy>
+void gaussian_blur_kernel(const ImageView &src, const ImageView &dst, int kernel_size, float sigma,
+                          GaussianMethod method = GAUSSIAN_AUTO)
+{
+    if (kernel_size <= 0 || kernel_size % 2 == 0)
+    {
+        throw std::runtime_error("高斯核大小必须为正奇数");
+    }
+    if (sigma <= 0)
+    {
+        throw std::runtime_error("sigma必须大于0");
+    }
+    if (method == GAUSSIAN_AUTO)
+    {
+        method = choose_gaussian_method(kernel_size, sigma);
+    }
+    if (method == GAUSSIAN_RECURSIVE)
+    {
+        gaussian_blur_recursive<Policy>(src, dst, sigma);
+    }
+    else
+    {
+        gaussian_blur_separable<Policy>(src, dst, gaussian_effective_radius(kernel_size, sigma), sigma);
+    }
+}
+
+// ===================== 融合流水线 =====================
+// 多个算子串联时，按缓存大小的图块一次性算完整条流水线：每个图块向外扩展足够的邻域（halo），
+// 中间结果只存在于线程私有的小缓冲中，不会写回整幅图像，更不会落盘。
+// 单独调用的Sobel与自定义卷积也是只有一个算子的流水线。
+
+// 图像中的矩形区域[x0, x1) x [y0, y1)
+struct Region
+{
+    int x0, y0, x1, y1;
+
+    int width() const { return x1 - x0; }
+    int height() const { return y1 - y0; }
+};
+
+// 以图像坐标访问的缓冲区：view的(0, 0)对应图像中的(region.x0, region.y0)
+struct RegionView
+{
+    ImageView view;
+    Region region;
+
+    unsigned char *at(int x, int y) const
+    {
+        return view.row(y - region.y0) + (x - region.x0) * view.channels;
+    }
+};
+
+// 区域向外扩展halo后与图像求交
+inline Region expand_region(const Region &r, int halo, int width, int height)
+{
+    return Region{std::max(r.x0 - halo, 0), std::max(r.y0 - halo, 0),
+                  std::min(r.x1 + halo, width), std::min(r.y1 + halo, height)};
+}
+
+// 流水线中的一个算子
+class PipelineStage
+{
+public:
+    virtual ~PipelineStage() {}
+
+    // 计算一个输出像素需要的邻域半径
+    virtual int halo() const { return 0; }
+
+    virtual int output_channels(int in_channels) const { return in_channels; }
+
+    // run()在输入区域为in_width x in_height、in_channels通道时另外使用的线程私有缓冲字节数（上界）
+    virtual size_t scratch_bytes(int in_width, int in_height, int in_channels) const { return 0; }
+
+    // 计算out.region内的结果。in.region覆盖out.region向外扩展halo()后与图像的交集，
+    // 越过图像边界的邻域坐标按图像尺寸裁剪，因此结果与整幅图像一次算完完全一致
+    virtual void run(const RegionView &in, const RegionView &out, int imgW, int imgH) const = 0;
+};
+
+class GrayscaleStage : public PipelineStage
+{
+public:
+    int output_channels(int) const override { return 1; }
+
+    void run(const RegionView &in, const RegionView &out, int, int) const override
+    {
+        const Region &r = out.region;
+        for (int y = r.y0; y < r.y1; y++)
+        {
+            if (in.view.channels == 1)
+                memcpy(out.at(r.x0, y), in.at(r.x0, y), r.width());
+            else
+                point_ops.gray_row(in.at(r.x0, y), out.at(r.x0, y), r.width());
+        }
+    }
+};
+
+class BinaryStage : public PipelineStage
+{
+public:
+    explicit BinaryStage(int threshold) : threshold_(std::min(std::max(threshold, 0), 256)) {}
+
+    int output_channels(int) const override { return 1; }
+
+    void run(const RegionView &in, const RegionView &out, int, int) const override
+    {
+        const Region &r = out.region;
+        for (int y = r.y0; y < r.y1; y++)
+        {
+            const unsigned char *s = in.at(r.x0, y);
+            unsigned char *d = out.at(r.x0, y);
+            if (in.view.channels == 1)
+            {
+                for (int j = 0; j < r.width(); j++)
+                    d[j] = (s[j] >= threshold_) ? 255 : 0;
+            }
+            else
+            {
+                point_ops.binary_row(s, d, r.width(), threshold_);
+            }
+        }
+    }
+
+private:
+    int threshold_;
+};
+
+class BrightnessStage : public PipelineStage
+{
+public:
+    explicit BrightnessStage(int delta) : delta_(std::min(std::max(delta, -255), 255)) {}
+
+    void run(const RegionView &in, const RegionView &out, int, int) const override
+    {
+        const Region &r = out.region;
+        for (int y = r.y0; y < r.y1; y++)
+            point_ops.brightness_row(in.at(r.x0, y), out.at(r.x0, y), r.width() * in.view.channels, delta_);
+    }
+
+private:
+    int delta_;
+};
+
+class LutStage : public PipelineStage
+{
+public:
+    explicit LutStage(const PointLut &lut) : lut_(lut), uniform_(lut.uniform()) {}
+
+    void run(const RegionView &in, const RegionView &out, int, int) const override
+    {
+        const Region &r = out.region;
+        int cn = in.view.channels;
+        for (int y = r.y0; y < r.y1; y++)
+        {
+            if (cn == 1 || uniform_)
+                point_ops.lut_row(in.at(r.x0, y), out.at(r.x0, y), r.width() * cn, lut_.table[cn == 1 ? 3 : 0]);
+            else
+                point_ops.lut3_row(in.at(r.x0, y), out.at(r.x0, y), r.width(), lut_.table);
+        }
+    }
+
+private:
+    PointLut lut_;
+    bool uniform_;
+};
+
+// 图块内的可分离高斯模糊，累加顺序与gaussian_blur_separable相同，结果逐位一致
+class GaussianStage : public PipelineStage
+{
+public:
+    GaussianStage(int kernel_size, float sigma)
+    {
+        if (kernel_size <= 0 || kernel_size % 2 == 0)
+        {
+            throw std::runtime_error("高斯核大小必须为正奇数");
+        }
+        if (sigma <= 0)
+        {
+            throw std::runtime_error("sigma必须大于0");
+        }
+        radius_ = gaussian_effective_radius(kernel_size, sigma);
+        kernel_ = generate_gaussian_kernel_1d(radius_, sigma);
+    }
+
+    int halo() const override { return radius_; }
+
+    // padded、hbuf、acc三块float缓冲，输出区域不超过输入区域
+    size_t scratch_bytes(int in_width, int in_height, int in_channels) const override
+    {
+        size_t rowLen = (size_t)in_width * in_channels;
+        return ((size_t)(in_width + 2 * radius_) * in_channels + (size_t)in_height * rowLen + rowLen) * sizeof(float);
+    }
+
+    void run(const RegionView &in, const RegionView &out, int imgW, int imgH) const override
+    {
+        const Region &ir = in.region, &r = out.region;
+        int cn = in.view.channels, window = 2 * radius_ + 1;
+        int rowLen = r.width() * cn;
+        thread_local std::vector<float> padded, hbuf, acc;
+        padded.resize((size_t)(r.width() + 2 * radius_) * cn);
+        hbuf.resize((size_t)ir.height() * rowLen);
+        acc.resize(rowLen);
+
+        // 水平方向：计算输入区域每一行在输出列范围内的结果
+        for (int y = ir.y0; y < ir.y1; y++)
+        {
+            for (int x = r.x0 - radius_; x < r.x1 + radius_; x++)
+            {
+                const unsigned char *p = in.at(std::min(std::max(x, 0), imgW - 1), y);
+                for (int c = 0; c < cn; c++)
+                    padded[(x - r.x0 + radius_) * cn + c] = p[c];
+            }
+            float *h = &hbuf[(size_t)(y - ir.y0) * rowLen];
+            std::fill(h, h + rowLen, 0.0f);
+            for (int k = 0; k < window; k++)
+            {
+                const float *p = &padded[k * cn];
+                float wk = kernel_[k];
+#pragma omp simd
+                for (int i = 0; i < rowLen; i++)
+                    h[i] += wk * p[i];
+            }
+        }
+
+        // 垂直方向
+        for (int y = r.y0; y < r.y1; y++)
+        {
+            std::fill(acc.begin(), acc.end(), 0.0f);
+            for (int k = 0; k < window; k++)
+            {
+                int sy = std::min(std::max(y - radius_ + k, 0), imgH - 1);
+                const float *h = &hbuf[(size_t)(sy - ir.y0) * rowLen];
+                float wk = kernel_[k];
+#pragma omp simd
+                for (int i = 0; i < rowLen; i++)
+                    acc[i] += wk * h[i];
+            }
+            unsigned char *d = out.at(r.x0, y);
+            for (int i = 0; i < rowLen; i++)
+                d[i] = clamp((int)(acc[i] + 0.5f));
+        }
+    }
+
+private:
+    int radius_;
+    std::vector<float> kernel_;
+};
+
+// 检查卷积核形状并展开为按行存放的权重，除数折算进每个权重
+std::vector<float> flatten_convolution_kernel(const std::vector<std::vector<float>> &kernel_vec, float divisor,
+                                              int &kh, int &kw)
+{
+    kh = (int)kernel_vec.size();
+    kw = kh ? (int)kernel_vec[0].size() : 0;
+    if (kh % 2 == 0 || kw % 2 == 0)
+    {
+        throw std::runtime_error("卷积核的行数和列数必须为奇数");
+    }
+    if (divisor == 0)
+    {
+        throw std::runtime_error("除数不能为0");
+    }
+    std::vector<float> weights;
+    weights.reserve(kh * kw);
+    for (const auto &row : kernel_vec)
+    {
+        if ((int)row.size() != kw)
+        {
+            throw std::runtime_error("卷积核每一行的长度必须相同");
+        }
+        for (float w : row)
+            weights.push_back(w / divisor);
+    }
+    return weights;
+}
+
+// 自定义卷积引擎：任意奇数尺寸NxM的浮点卷积核，除数预先折算进权重，逐像素不再做除法。
+// 卷积窗口超出图像的最外hy行、hx列输出为0（与原3x3版本一致），结果四舍五入。
+// 图块内按列块累加：每个输出行的一个列块对应一段L1大小的浮点累加器，
+// 每个核元素只是“累加器 += 权重 × 一段连续的源像素”，可以直接向量化。
+// 3/5/7这几种常用尺寸在编译期展开，其余尺寸走运行时循环。
+template <int KH, int KW>
+void convolve_region(const RegionView &in, const RegionView &out, int imgW, int imgH,
+                     const float *weights, int runtime_kh, int runtime_kw)
+{
+    const int kh = KH ? KH : runtime_kh, kw = KW ? KW : runtime_kw;
+    const int hy = kh / 2, hx = kw / 2;
+    const int cn = in.view.channels;
+    const Region &r = out.region;
+    float acc[192];
+    const int blockPixels = 192 / cn;
+
+    // 卷积窗口完全位于图像内的列范围
+    int xs = std::max(r.x0, hx), xe = std::min(r.x1, imgW - hx);
+    for (int y = r.y0; y < r.y1; y++)
+    {
+        unsigned char *d = out.at(r.x0, y);
+        if (y < hy || y >= imgH - hy || xs >= xe)
+        {
+            memset(d, 0, (size_t)r.width() * cn);
+            continue;
+        }
+        memset(d, 0, (size_t)(xs - r.x0) * cn);
+        memset(out.at(xe, y), 0, (size_t)(r.x1 - xe) * cn);
+
+        for (int bx = xs; bx < xe; bx += blockPixels)
+        {
+            int len = std::min(blockPixels, xe - bx) * cn;
+            std::fill(acc, acc + len, 0.0f);
+            for (int ky = 0; ky < kh; ky++)
+            {
+                const unsigned char *srow = in.at(bx - hx, y - hy + ky);
+                const float *wrow = weights + ky * kw;
+                for (int kx = 0; kx < kw; kx++)
+                {
+                    const unsigned char *p = srow + kx * cn;
+                    float w = wrow[kx];
+#pragma omp simd
+                    for (int i = 0; i < len; i++)
+                        acc[i] += w * p[i];
+                }
+            }
+            unsigned char *o = out.at(bx, y);
+            for (int i = 0; i < len; i++)
+            {
+                float v = acc[i] + 0.5f;
+                o[i] = (v <= 0.0f) ? 0 : (v >= 255.0f ? 255 : (unsigned char)v);
+            }
+        }
+    }
+}
+
+class ConvolutionStage : public PipelineStage
+{
+public:
+    ConvolutionStage(const std::vector<std::vector<float>> &kernel_vec, float divisor)
+        : weights_(flatten_convolution_kernel(kernel_vec, divisor, kh_, kw_)) {}
+
+    int halo() const override { return std::max(kh_, kw_) / 2; }
+
+    void run(const RegionView &in, const RegionView &out, int imgW, int imgH) const override
+    {
+        const float *w = weights_.data();
+        if (kh_ == kw_ && kh_ == 3)
+            convolve_region<3, 3>(in, out, imgW, imgH, w, kh_, kw_);
+        else if (kh_ == kw_ && kh_ == 5)
+            convolve_region<5, 5>(in, out, imgW, imgH, w, kh_, kw_);
+        else if (kh_ == kw_ && kh_ == 7)
+            convolve_region<7, 7>(in, out, imgW, imgH, w, kh_, kw_);
+        else
+            convolve_region<0, 0>(in, out, imgW, imgH, w, kh_, kw_);
+    }
+
+private:
+    int kh_, kw_;
+    std::vector<float> weights_; // 按行存放的kh_ x kw_权重，已除以divisor
+};
+
+// Sobel边缘检测：最外一圈像素输出为0。
+// keep_channels为true时输出与输入通道数相同（每个通道写入同一边缘强度），否则输出单通道
+// Sobel的两个3x3核都可分离：先在垂直方向求平滑(1,2,1)与差分(-1,0,1)，再在水平方向分别做差分与平滑，
+// 每像素6次加减代替18次乘加，全部是16位整数运算，可以直接向量化。
+// 垂直方向：g0、g1、g2为上、中、下三行亮度，各n个值
+inline void sobel_vertical(const unsigned char *g0, const unsigned char *g1, const unsigned char *g2, int n,
+                           short *smooth, short *diff)
+{
+#pragma omp simd
+    for (int x = 0; x < n; x++)
+    {
+        smooth[x] = (short)(g0[x] + 2 * g1[x] + g2[x]);
+        diff[x] = (short)(g2[x] - g0[x]);
+    }
+}
+
+// 一行n个像素的Sobel梯度幅值：g0、g1、g2各自指向第一个输出像素左边一列，需有n+2个值
+inline void sobel_row(const unsigned char *g0, const unsigned char *g1, const unsigned char *g2, int n,
+                      short *smooth, short *diff, unsigned char *mag)
+{
+    sobel_vertical(g0, g1, g2, n + 2, smooth, diff);
+    // 幅值先截到255²，开方结果不超过255；不超过2^24的整数在float中精确表示，取整与整数开方一致
+#pragma omp simd
+    for (int x = 0; x < n; x++)
+    {
+        int gx = smooth[x + 2] - smooth[x];
+        int gy = diff[x] + 2 * diff[x + 1] + diff[x + 2];
+        int v = std::min(gx * gx + gy * gy, 255 * 255);
+        mag[x] = (unsigned char)(int)sqrtf((float)v);
+    }
+}
+
+// 把单通道的一行写成cn个相同的通道
+inline void replicate_channels(const unsigned char *s, unsigned char *d, int n, int cn)
+{
+    if (cn == 1)
+    {
+        memcpy(d, s, n);
+        return;
+    }
+    for (int x = 0; x < n; x++)
+        for (int c = 0; c < cn; c++)
+            d[x * cn + c] = s[x];
+}
+
+// Sobel边缘检测：先用点运算的SIMD灰度转换把输入区域算成一块亮度平面（每个像素只转换一次），
+// 再在亮度平面上做可分离的整数Sobel。图像最外一圈像素输出为0
+class SobelStage : public PipelineStage
+{
+public:
+    explicit SobelStage(bool keep_channels = false) : keep_channels_(keep_channels) {}
+
+    int halo() const override { return 1; }
+
+    int output_channels(int in_channels) const override { return keep_channels_ ? in_channels : 1; }
+
+    // 多通道输入时的亮度平面，加上mag、smooth、diff三行
+    size_t scratch_bytes(int in_width, int in_height, int in_channels) const override
+    {
+        size_t plane = (in_channels != 1) ? (size_t)in_width * in_height : 0;
+        return plane + (size_t)in_width * (1 + 2 * sizeof(short));
+    }
+
+    void run(const RegionView &in, const RegionView &out, int imgW, int imgH) const override
+    {
+        const Region &ir = in.region, &r = out.region;
+        int cn = in.view.channels, ocn = out.view.channels;
+        int iw = ir.width();
+        thread_local std::vector<unsigned char> gray, mag;
+        thread_local std::vector<short> smooth, diff;
+        gray.resize((size_t)iw * ir.height());
+        mag.resize(iw);
+        smooth.resize(iw);
+        diff.resize(iw);
+
+        // 单通道输入本身就是亮度平面，不必复制
+        const unsigned char *plane = in.view.data;
+        ptrdiff_t planeStride = in.view.stride;
+        if (cn != 1)
+        {
+            for (int y = ir.y0; y < ir.y1; y++)
+                point_ops.gray_row(in.at(ir.x0, y), &gray[(size_t)(y - ir.y0) * iw], iw);
+            plane = gray.data();
+            planeStride = iw;
+        }
+
+        // 只有离开图像边框的像素才有完整的3x3邻域
+        int xa = std::max(r.x0, 1), xb = std::min(r.x1, imgW - 1);
+        for (int y = r.y0; y < r.y1; y++)
+        {
+            unsigned char *d = out.at(r.x0, y);
+            if (y == 0 || y == imgH - 1 || xa >= xb)
+            {
+                memset(d, 0, (size_t)r.width() * ocn);
+                continue;
+            }
+            const unsigned char *g1 = plane + (y - ir.y0) * planeStride + (xa - 1 - ir.x0);
+            sobel_row(g1 - planeStride, g1, g1 + planeStride, xb - xa, smooth.data(), diff.data(), mag.data());
+            memset(d, 0, (size_t)(xa - r.x0) * ocn);
+            replicate_channels(mag.data(), d + (size_t)(xa - r.x0) * ocn, xb - xa, ocn);
+            memset(d + (size_t)(xb - r.x0) * ocn, 0, (size_t)(r.x1 - xb) * ocn);
+        }
+    }
+
+private:
+    bool keep_channels_;
+};
+
+// 按顺序串联的算子序列
+class Pipeline
+{
+public:
+    void add(std::shared_ptr<const PipelineStage> stage) { stages_.push_back(stage); }
+
+    bool empty() const { return stages_.empty(); }
+
+    int output_channels(int in_channels) const
+    {
+        for (const auto &stage : stages_)
+            in_channels = stage->output_channels(in_channels);
+        return in_channels;
+    }
+
+    // 所有算子的邻域半径之和，即一个图块需要向外读取的宽度
+    int total_halo() const
+    {
+        int halo = 0;
+        for (const auto &stage : stages_)
+            halo += stage->halo();
+        return halo;
+    }
+
+    // 每个线程执行run_band时占用的内存上界（字节）：两块交替的中间图块缓冲，加上各算子的线程私有缓冲。
+    // 算子的thread_local缓冲在调用结束后仍保留，因此按所有算子之和计算
+    size_t thread_bytes(int width, int in_channels) const
+    {
+        int n = (int)stages_.size(), tileW, tileH;
+        tile_size(width, INT_MAX, tileW, tileH);
+        size_t buffers[2] = {0, 0}, scratch = 0;
+        int halo = total_halo(), cn = in_channels;
+        for (int i = 0; i < n; i++)
+        {
+            // 第i个算子的输入区域是输出图块向外扩展其后所有算子（含自身）的邻域，不与图像求交，取上界
+            int w = tileW + 2 * halo, h = tileH + 2 * halo;
+            scratch += stages_[i]->scratch_bytes(w, h, cn);
+            halo -= stages_[i]->halo();
+            cn = stages_[i]->output_channels(cn);
+            if (i < n - 1)
+                buffers[i % 2] = std::max(buffers[i % 2], (size_t)(tileW + 2 * halo) * (tileH + 2 * halo) * cn);
+        }
+        return buffers[0] + buffers[1] + scratch;
+    }
+
+    // 分块融合执行：dst的通道数须等于output_channels(src.channels)，src与dst不能重叠
+    template <typename Policy = OmpRuntimePolicy>
+    void run(const ImageView &src, const ImageView &dst) const
+    {
+        run_band<Policy>(src, 0, dst, 0, src.height);
+    }
+
+    // 只计算一条水平条带：图像高imgH，dst保存第dstY0行起的dst.height行结果，
+    // src保存第srcY0行起的src.height行输入，须覆盖dst条带上下各扩展total_halo()行（与图像求交）后的范围
+    template <typename Policy = OmpRuntimePolicy>
+    void run_band(const ImageView &src, int srcY0, const ImageView &dst, int dstY0, int imgH) const
+    {
+        int width = src.width, height = imgH;
+        int bandY0 = dstY0, bandY1 = dstY0 + dst.height;
+        int n = (int)stages_.size();
+        if (bandY1 <= bandY0)
+            return;
+        if (n == 0)
+        {
+            parallel_for<Policy>(bandY1 - bandY0, [&](int i) {
+                memcpy(dst.row(i), src.row(bandY0 + i - srcY0), (size_t)width * src.channels);
+            });
+            return;
+        }
+
+        std::vector<int> channels(n + 1);
+        channels[0] = src.channels;
+        for (int i = 0; i < n; i++)
+            channels[i + 1] = stages_[i]->output_channels(channels[i]);
+
+        int tileW, tileH;
+        tile_size(width, bandY1 - bandY0, tileW, tileH);
+        int tilesX = (width + tileW - 1) / tileW, tilesY = (bandY1 - bandY0 + tileH - 1) / tileH;
+
+        // 线程私有的各级图块区域，以及两块交替使用的中间缓冲
+        struct TileBuffers
+        {
+            std::vector<unsigned char> buffers[2];
+            std::vector<Region> regions;
+        };
+        auto init = [&] {
+            TileBuffers b;
+            b.regions.resize(n + 1);
+            return b;
+        };
+
+        Policy::for_each(tilesX * tilesY, init, [&](TileBuffers &b, int t) {
+            std::vector<Region> &regions = b.regions;
+            int tx = t % tilesX, ty = t / tilesX;
+            regions[n] = Region{tx * tileW, bandY0 + ty * tileH,
+                                std::min((tx + 1) * tileW, width), std::min(bandY0 + (ty + 1) * tileH, bandY1)};
+            for (int i = n - 1; i >= 0; i--)
+                regions[i] = expand_region(regions[i + 1], stages_[i]->halo(), width, height);
+
+            // 第一个算子直接读源图像，最后一个算子直接写目标图像
+            RegionView in{ImageView{src.row(regions[0].y0 - srcY0) + (ptrdiff_t)regions[0].x0 * src.channels,
+                                    regions[0].width(), regions[0].height(), src.stride, src.channels},
+                          regions[0]};
+            for (int i = 0; i < n; i++)
+            {
+                const Region &r = regions[i + 1];
+                RegionView out;
+                if (i == n - 1)
+                {
+                    out = RegionView{ImageView{dst.row(r.y0 - dstY0) + (ptrdiff_t)r.x0 * dst.channels,
+                                               r.width(), r.height(), dst.stride, dst.channels},
+                                     r};
+                }
+                else
+                {
+                    std::vector<unsigned char> &buf = b.buffers[i % 2];
+                    int cn = channels[i + 1];
+                    buf.resize((size_t)r.width() * r.height() * cn);
+                    out = RegionView{ImageView{buf.data(), r.width(), r.height(), (ptrdiff_t)r.width() * cn, cn}, r};
+                }
+                stages_[i]->run(in, out, width, height);
+                in = out;
+            }
+        });
+    }
+
+private:
+    // 图块大小：中间缓冲保持在L2以内，邻域较大时相应放大图块以摊薄重复计算
+    void tile_size(int width, int bandRows, int &tileW, int &tileH) const
+    {
+        int halo = total_halo();
+        tileW = std::min(width, std::max(256, 4 * halo));
+        tileH = std::min(bandRows, std::max(64, 4 * halo));
+    }
+
+    std::vector<std::shared_ptr<const PipelineStage>> stages_;
+};
+
+// 只有一个算子的流水线
+template <typename Policy = OmpRuntimePolicy>
+void run_stage(std::shared_ptr<const PipelineStage> stage, const ImageView &src, const ImageView &dst)
+{
+    Pipeline pipeline;
+    pipeline.add(stage);
+    pipeline.run<Policy>(src, dst);
+}
+
+// ===================== FFT卷积 =====================
+// 直接卷积每像素需要kh·kw次乘加，大卷积核时改用FFT，每像素的计算量只与FFT尺寸的对数有关。
+// 图像按overlap-save方式切成互不重叠的输出块：每块读入带邻域的Nh x Nw输入，做二维FFT后
+// 与卷积核频谱相乘再逆变换，丢掉循环卷积回绕的部分。块之间互不依赖，按块并行。
+// 卷积核是实数，两个通道可以分别作为实部和虚部放进同一次复数FFT（B+iG、R），三个通道只需两次变换。
+
+// 自定义卷积的实现方式
+enum ConvolutionMethod
+{
+    CONVOLUTION_AUTO,   // 按计算量估算自动选择
+    CONVOLUTION_DIRECT, // 分块直接卷积，每像素O(kh·kw)
+    CONVOLUTION_FFT     // 分块FFT卷积，每像素O(log(Nh·Nw))
+};
+
+ConvolutionMethod parse_convolution_method(const std::string &method)
+{
+    if (method == "auto")
+        return CONVOLUTION_AUTO;
+    if (method == "direct")
+        return CONVOLUTION_DIRECT;
+    if (method == "fft")
+        return CONVOLUTION_FFT;
+    throw std::runtime_error("未知的卷积方式: " + method);
+}
+
+typedef std::complex<float> cfloat;
+
+// 复数乘法（std::complex的operator*要处理inf/nan，不能内联展开）
+static inline cfloat cmul(cfloat a, cfloat b)
+{
+    return cfloat(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+// 长度为2的幂的基2复数FFT，逆变换不含1/n缩放
+class Fft
+{
+public:
+    explicit Fft(int n) : n_(n), rev_(n), forward_(n / 2), inverse_(n / 2)
+    {
+        int bits = 0;
+        while ((1 << bits) < n)
+            bits++;
+        for (int i = 0; i < n; i++)
+        {
+            int r = 0;
+            for (int b = 0; b < bits; b++)
+                r |= ((i >> b) & 1) << (bits - 1 - b);
+            rev_[i] = r;
+        }
+        for (int i = 0; i < n / 2; i++)
+        {
+            double angle = -2.0 * M_PI * i / n;
+            forward_[i] = cfloat((float)cos(angle), (float)sin(angle));
+            inverse_[i] = std::conj(forward_[i]);
+        }
+    }
+
+    int size() const { return n_; }
+
+    void transform(cfloat *a, bool inverse) const
+    {
+        const cfloat *twiddle = inverse ? inverse_.data() : forward_.data();
+        for (int i = 0; i < n_; i++)
+        {
+            if (i < rev_[i])
+                std::swap(a[i], a[rev_[i]]);
+        }
+        for (int len = 2; len <= n_; len <<= 1)
+        {
+            int half = len / 2, step = n_ / len;
+            for (int i = 0; i < n_; i += len)
+            {
+                for (int j = 0; j < half; j++)
+                {
+                    cfloat u = a[i + j], v = cmul(a[i + j + half], twiddle[j * step]);
+                    a[i + j] = u + v;
+                    a[i + j + half] = u - v;
+                }
+            }
+        }
+    }
+
+private:
+    int n_;
+    std::vector<int> rev_;
+    std::vector<cfloat> forward_, inverse_;
+};
+
+// rows x cols矩阵分块转置
+static void transpose_block(const cfloat *src, cfloat *dst, int rows, int cols)
+{
+    const int B = 16;
+    for (int i0 = 0; i0 < rows; i0 += B)
+        for (int j0 = 0; j0 < cols; j0 += B)
+            for (int i = i0; i < std::min(i0 + B, rows); i++)
+                for (int j = j0; j < std::min(j0 + B, cols); j++)
+                    dst[(size_t)j * rows + i] = src[(size_t)i * cols + j];
+}
+
+// Nh x Nw的二维FFT。正变换的结果按转置（Nw x Nh）存放在t中，逆变换从转置的频谱恢复到a，
+// 频域里只做逐元素乘法，不关心布局，所以每个方向只需一次转置
+static void fft2d_forward(cfloat *a, cfloat *t, const Fft &fh, const Fft &fw)
+{
+    int nh = fh.size(), nw = fw.size();
+    for (int y = 0; y < nh; y++)
+        fw.transform(a + (size_t)y * nw, false);
+    transpose_block(a, t, nh, nw);
+    for (int x = 0; x < nw; x++)
+        fh.transform(t + (size_t)x * nh, false);
+}
+
+static void fft2d_inverse(cfloat *t, cfloat *a, const Fft &fh, const Fft &fw)
+{
+    int nh = fh.size(), nw = fw.size();
+    for (int x = 0; x < nw; x++)
+        fh.transform(t + (size_t)x * nh, true);
+    transpose_block(t, a, nw, nh);
+    for (int y = 0; y < nh; y++)
+        fw.transform(a + (size_t)y * nw, true);
+}
+
+static int next_pow2(int n)
+{
+    int p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+// 一个方向上的FFT长度：约为核大小的4倍（回绕丢弃的部分不超过1/4），但不超过一次就能覆盖整幅图像的长度
+static int fft_tile_size(int k, int extent)
+{
+    return std::min(next_pow2(std::max(128, 4 * k)), next_pow2(extent + k - 1));
+}
+
+// 一次标量蝶形运算相当于多少次向量化的直接卷积乘加。这是经验取值，不是标定结果：蝶形是标量的复数乘加，
+// 直接卷积一条向量指令做多次乘加，两者相差数倍。选错只发生在两者耗时接近的核大小附近，代价有限。
+// 在单个AVX-512核上对1024x1024三通道图像、5~41的方形核分别计时，由耗时比反推的系数在6~10之间，
+// 实际分界在13与15之间，按6估算在13时已选FFT
+static const double FFT_BUTTERFLY_COST = 6.0;
+
+// 估算FFT卷积相对直接卷积是否更省：直接卷积每像素每通道kh·kw次（向量化的）乘加；
+// FFT每块每两个通道做一次正变换和一次逆变换，每次约Nh·Nw·log2(Nh·Nw)次（标量的）蝶形运算
+ConvolutionMethod choose_convolution_method(int width, int height, int channels, int kh, int kw)
+{
+    int ow = width - kw + 1, oh = height - kh + 1;
+    if (ow <= 0 || oh <= 0)
+        return CONVOLUTION_DIRECT;
+    int nh = fft_tile_size(kh, height), nw = fft_tile_size(kw, width);
+    double tiles = std::ceil((double)oh / (nh - kh + 1)) * std::ceil((double)ow / (nw - kw + 1));
+    double planes = (channels + 1) / 2;
+    double n = (double)nh * nw;
+    double fftCost = tiles * planes * 2.0 * n * std::log2(n) * FFT_BUTTERFLY_COST;
+    double directCost = (double)ow * oh * channels * kh * kw;
+    return fftCost < directCost ? CONVOLUTION_FFT : CONVOLUTION_DIRECT;
+}
+
+// FFT卷积核心：与ConvolutionStage结果一致（误差在舍入上下1以内），卷积窗口超出图像的边框输出为0。
+// weights为按行存放、已除以divisor的kh x kw权重
+template <typename Policy>
+void fft_convolve(const ImageView &src, const ImageView &dst, const float *weights, int kh, int kw)
+{
+    int width = src.width, height = src.height, cn = src.channels;
+    int hy = kh / 2, hx = kw / 2;
+    int oh = height - kh + 1, ow = width - kw + 1; // 有效输出区域为[hy, hy+oh) x [hx, hx+ow)
+
+    parallel_for<Policy>(height, [&](int y) {
+        unsigned char *d = dst.row(y);
+        if (y < hy || y >= hy + oh || ow <= 0)
+        {
+            memset(d, 0, (size_t)width * cn);
+            return;
+        }
+        memset(d, 0, (size_t)hx * cn);
+        memset(d + (size_t)(hx + ow) * cn, 0, (size_t)(width - hx - ow) * cn);
+    });
+    if (oh <= 0 || ow <= 0)
+        return;
+
+    Fft fh(fft_tile_size(kh, height)), fw(fft_tile_size(kw, width));
+    int nh = fh.size(), nw = fw.size();
+    int bh = nh - kh + 1, bw = nw - kw + 1; // 每块的有效输出尺寸
+    size_t n = (size_t)nh * nw;
+
+    // 相关运算 r[n] = Σ x[n+m]·k[m] 对应频域 X·conj(K)；1/(Nh·Nw)的逆变换缩放也折算进去
+    std::vector<cfloat> kernelSpectrum(n), scratch(n);
+    for (int i = 0; i < kh; i++)
+        for (int j = 0; j < kw; j++)
+            scratch[(size_t)i * nw + j] = cfloat(weights[i * kw + j], 0.0f);
+    fft2d_forward(scratch.data(), kernelSpectrum.data(), fh, fw);
+    float scale = 1.0f / (float)n;
+    for (size_t i = 0; i < n; i++)
+        kernelSpectrum[i] = std::conj(kernelSpectrum[i]) * scale;
+
+    int tilesX = (ow + bw - 1) / bw, tilesY = (oh + bh - 1) / bh;
+    int planes = (cn + 1) / 2;
+    int jobs = tilesX * tilesY * planes;
+
+    // 每个线程一对FFT工作缓冲
+    struct FftBuffers
+    {
+        std::vector<cfloat> a, t;
+    };
+    auto init = [&] {
+        FftBuffers b;
+        b.a.resize(n);
+        b.t.resize(n);
+        return b;
+    };
+
+    Policy::for_each(jobs, init, [&](FftBuffers &b, int job) {
+        std::vector<cfloat> &a = b.a, &t = b.t;
+        int plane = job % planes, tile = job / planes;
+        int oy = (tile / tilesX) * bh, ox = (tile % tilesX) * bw; // 块左上角在有效输出区域中的坐标
+        int c0 = plane * 2, c1 = plane * 2 + 1;
+
+        // 输入块的左上角就是输出(oy, ox)的卷积窗口左上角，越过图像的部分补0（只会影响被丢弃的输出）
+        for (int i = 0; i < nh; i++)
+        {
+            cfloat *row = &a[(size_t)i * nw];
+            int sy = oy + i;
+            int cols = (sy < height) ? std::min(nw, width - ox) : 0;
+            if (cols > 0)
+            {
+                const unsigned char *s = src.row(sy) + (size_t)ox * cn;
+                for (int j = 0; j < cols; j++)
+                    row[j] = cfloat(s[j * cn + c0], c1 < cn ? s[j * cn + c1] : 0);
+            }
+            std::fill(row + std::max(cols, 0), row + nw, cfloat(0.0f, 0.0f));
+        }
+
+        fft2d_forward(a.data(), t.data(), fh, fw);
+        for (size_t i = 0; i < n; i++)
+            t[i] = cmul(t[i], kernelSpectrum[i]);
+        fft2d_inverse(t.data(), a.data(), fh, fw);
+
+        int rows = std::min(bh, oh - oy), cols = std::min(bw, ow - ox);
+        for (int i = 0; i < rows; i++)
+        {
+            const cfloat *r = &a[(size_t)i * nw];
+            unsigned char *d = dst.row(oy + hy + i) + (size_t)(ox + hx) * cn;
+            for (int j = 0; j < cols; j++)
+            {
+                d[j * cn + c0] = clamp((int)std::floor(r[j].real() + 0.5f));
+                if (c1 < cn)
+                    d[j * cn + c1] = clamp((int)std::floor(r[j].imag() + 0.5f));
+            }
+        }
+    });
+}
+
+// 自定义卷积核心：任意奇数尺寸的浮点卷积核，卷积窗口超出图像的边框输出为0
+template <typename Policy = OmpRuntimePolicy>
+void custom_convolution_kernel(const ImageView &src, const ImageView &dst,
+                               const std::vector<std::vector<float>> &kernel_vec, float divisor,
+                               ConvolutionMethod method = CONVOLUTION_AUTO)
+{
+    int kh, kw;
+    std::vector<float> weights = flatten_convolution_kernel(kernel_vec, divisor, kh, kw);
+    if (method == CONVOLUTION_AUTO)
+    {
+        method = choose_convolution_method(src.width, src.height, src.channels, kh, kw);
+    }
+    if (method == CONVOLUTION_FFT)
+    {
+        fft_convolve<Policy>(src, dst, weights.data(), kh, kw);
+    }
+    else
+    {
+        run_stage<Policy>(std::make_shared<ConvolutionStage>(kernel_vec, divisor), src, dst);
+    }
+}
+
+// Sobel边缘检测核心：dst为单通道，或与src通道数相同、每个通道都写入边缘强度，最外一圈像素输出为0
+template <typename Policy = OmpRuntimePolicy>
+void sobel_kernel(const ImageView &src, const ImageView &dst)
+{
+    run_stage<Policy>(std::make_shared<SobelStage>(dst.channels != 1), src, dst);
+}
+
+// ===================== Canny边缘检测 =====================
+// 灰度 → 高斯平滑 → Sobel梯度 → 非极大值抑制 → 双阈值滞后连接，前四步复用上面的计算核心。
+// 梯度与非极大值抑制按行块融合：每个行块在线程私有缓冲里算出本块及上下各一行的梯度，
+// 直接抑制后把结果写进输出，不保存整幅梯度图。输出先暂存每个像素的状态（0/弱/强），
+// 滞后连接从所有强边缘像素出发按前沿并行扩展，最后把强边缘写成255、其余写成0。
+
+static const int CANNY_TILE_ROWS = 16;
+static const int CANNY_TRACE_CHUNK = 1024;   // 前沿中每个任务负责的起点数
+static const int CANNY_TRACE_BUDGET = 65536; // 一个任务连续追踪的像素数上限，超出的留给下一轮重新分配
+static const unsigned char CANNY_WEAK = 1, CANNY_STRONG = 2;
+
+// tan(22.5°)的Q15定点值，用于不做除法地把梯度方向量化到4个方向
+static const int CANNY_TG22 = 13573;
+
+// 一行的梯度：g0、g1、g2为上、中、下三行平滑后的亮度，首尾两列梯度与幅值记为0。
+// 幅值用L1范数|gx|+|gy|，l2为true时用L2范数的平方（阈值相应取平方，比较结果不变）
+inline void canny_gradient_row(const unsigned char *g0, const unsigned char *g1, const unsigned char *g2, int width,
+                               bool l2, short *smooth, short *diff, short *gx, short *gy, int *mag)
+{
+    sobel_vertical(g0, g1, g2, width, smooth, diff);
+#pragma omp simd
+    for (int x = 1; x < width - 1; x++)
+    {
+        int dx = smooth[x + 1] - smooth[x - 1];
+        int dy = diff[x - 1] + 2 * diff[x] + diff[x + 1];
+        gx[x] = (short)dx;
+        gy[x] = (short)dy;
+        mag[x] = l2 ? dx * dx + dy * dy : std::abs(dx) + std::abs(dy);
+    }
+    gx[0] = gy[0] = gx[width - 1] = gy[width - 1] = 0;
+    mag[0] = mag[width - 1] = 0;
+}
+
+// 梯度与非极大值抑制：blurred为平滑后的单通道图像，dst中写入每个像素的状态，
+// strong按行块收集强边缘像素的地址，作为滞后连接的起点
+template <typename Policy>
+void canny_suppress(const ImageView &blurred, const ImageView &dst, int low, int high, bool l2,
+                    std::vector<std::vector<unsigned char *>> &strong)
+{
+    int width = blurred.width, height = blurred.height;
+    int tiles = (height + CANNY_TILE_ROWS - 1) / CANNY_TILE_ROWS;
+    strong.assign(tiles, std::vector<unsigned char *>());
+
+    // 行块及上下各一行的梯度，第i行缓冲对应图像第y0-1+i行
+    struct GradientRows
+    {
+        std::vector<short> smooth, diff, gx, gy;
+        std::vector<int> mag;
+    };
+    auto init = [&] {
+        GradientRows b;
+        size_t n = (size_t)(CANNY_TILE_ROWS + 2) * width;
+        b.smooth.resize(width);
+        b.diff.resize(width);
+        b.gx.resize(n);
+        b.gy.resize(n);
+        b.mag.resize(n);
+        return b;
+    };
+
+    Policy::for_each(tiles, init, [&](GradientRows &b, int t) {
+        int y0 = t * CANNY_TILE_ROWS, y1 = std::min(y0 + CANNY_TILE_ROWS, height);
+        for (int y = y0 - 1; y <= y1; y++)
+        {
+            size_t o = (size_t)(y - y0 + 1) * width;
+            if (y <= 0 || y >= height - 1)
+            {
+                // 图像最外一圈没有完整的3x3邻域，幅值记为0，既不会成为边缘，也不会压制相邻像素
+                std::fill(&b.mag[o], &b.mag[o] + width, 0);
+                continue;
+            }
+            canny_gradient_row(blurred.row(y - 1), blurred.row(y), blurred.row(y + 1), width, l2, b.smooth.data(),
+                               b.diff.data(), &b.gx[o], &b.gy[o], &b.mag[o]);
+        }
+
+        for (int y = y0; y < y1; y++)
+        {
+            unsigned char *d = dst.row(y);
+            memset(d, 0, width);
+            if (y == 0 || y == height - 1)
+                continue;
+            size_t o = (size_t)(y - y0 + 1) * width;
+            const int *m0 = &b.mag[o - width], *m1 = &b.mag[o], *m2 = &b.mag[o + width];
+            for (int x = 1; x < width - 1; x++)
+            {
+                int m = m1[x];
+                if (m <= low)
+                    continue;
+                // 按梯度方向取两侧相邻像素比较；一侧用>=，相等的平台只保留一个像素
+                int dx = b.gx[o + x], dy = b.gy[o + x];
+                int ax = std::abs(dx), ay = std::abs(dy);
+                int tg22x = ax * CANNY_TG22, ys = ay << 15;
+                bool keep;
+                if (ys < tg22x)
+                {
+                    keep = m > m1[x - 1] && m >= m1[x + 1];
+                }
+                else if (ys > tg22x + (ax << 16))
+                {
+                    keep = m > m0[x] && m >= m2[x];
+                }
+                else
+                {
+                    int sx = ((dx ^ dy) < 0) ? -1 : 1;
+                    keep = m > m0[x - sx] && m > m2[x + sx];
+                }
+                if (!keep)
+                    continue;
+                if (m > high)
+                {
+                    d[x] = CANNY_STRONG;
+                    strong[t].push_back(d + x);
+                }
+                else
+                {
+                    d[x] = CANNY_WEAK;
+                }
+            }
+        }
+    });
+}
+
+// 滞后连接：与强边缘8邻接的弱边缘像素升级为强边缘，直到不再变化。
+// 每轮把前沿切成若干任务，任务内用栈做深度优先追踪；弱像素用原子交换认领，保证每个像素只被追踪一次。
+// 单个任务追踪超过CANNY_TRACE_BUDGET个像素后，剩下的栈作为下一轮的前沿重新分给各线程，避免一条长边拖住一个线程
+template <typename Policy>
+void canny_hysteresis(const ImageView &dst, std::vector<std::vector<unsigned char *>> &frontier)
+{
+    ptrdiff_t stride = dst.stride;
+    const ptrdiff_t offsets[8] = {-stride - 1, -stride, -stride + 1, -1, 1, stride - 1, stride, stride + 1};
+
+    std::vector<unsigned char *> seeds;
+    for (;;)
+    {
+        seeds.clear();
+        for (auto &part : frontier)
+            seeds.insert(seeds.end(), part.begin(), part.end());
+        if (seeds.empty())
+            break;
+        int chunks = (int)((seeds.size() + CANNY_TRACE_CHUNK - 1) / CANNY_TRACE_CHUNK);
+        frontier.assign(chunks, std::vector<unsigned char *>());
+
+        parallel_for<Policy>(chunks, [&](int c) {
+            std::vector<unsigned char *> &stack = frontier[c];
+            size_t begin = (size_t)c * CANNY_TRACE_CHUNK, end = std::min(begin + CANNY_TRACE_CHUNK, seeds.size());
+            stack.assign(seeds.begin() + begin, seeds.begin() + end);
+            for (int budget = CANNY_TRACE_BUDGET; budget > 0 && !stack.empty(); budget--)
+            {
+                unsigned char *p = stack.back();
+                stack.pop_back();
+                for (ptrdiff_t off : offsets)
+                {
+                    unsigned char *q = p + off;
+                    // 其他线程可能同时认领该像素，预先检查也必须是原子读，否则按OpenMP内存模型构成数据竞争
+                    unsigned char seen;
+#pragma omp atomic read
+                    seen = *q;
+                    if (seen != CANNY_WEAK)
+                        continue;
+                    unsigned char old;
+#pragma omp atomic capture
+                    {
+                        old = *q;
+                        *q = CANNY_STRONG;
+                    }
+                    if (old == CANNY_WEAK)
+                        stack.push_back(q);
+                }
+            }
+        });
+    }
+}
+
+// Canny边缘检测核心：src为1或3通道，dst为单通道，边缘为255、其余为0，图像最外一圈输出为0。
+// kernel_size为0时不做高斯平滑；阈值与幅值的单位同OpenCV的Canny（L1范数，l2为true时为L2范数）
+template <typename Policy = OmpRuntimePolicy>
+void canny_kernel(const ImageView &src, const ImageView &dst, double low_threshold, double high_threshold,
+                  int kernel_size, float sigma, bool l2)
+{
+    if (low_threshold < 0 || low_threshold > high_threshold)
+    {
+        throw std::runtime_error("Canny阈值必须满足0 <= low_threshold <= high_threshold");
+    }
+    int width = src.width, height = src.height;
+    std::vector<unsigned char> grayBuf((size_t)width * height), blurBuf;
+    ImageView gray = {grayBuf.data(), width, height, width, 1};
+    grayscale_kernel<Policy>(src, gray);
+    ImageView blurred = gray;
+    if (kernel_size != 0)
+    {
+        blurBuf.resize(grayBuf.size());
+        blurred.data = blurBuf.data();
+        gaussian_blur_kernel<Policy>(gray, blurred, kernel_size, sigma);
+    }
+
+    // 幅值是整数，m > t等价于m > floor(t)
+    auto threshold = [&](double t) { return (int)std::min(std::floor(l2 ? t * t : t), 1e9); };
+    std::vector<std::vector<unsigned char *>> frontier;
+    canny_suppress<Policy>(blurred, dst, threshold(low_threshold), threshold(high_threshold), l2, frontier);
+    canny_hysteresis<Policy>(dst, frontier);
+
+    parallel_for<Policy>(height, [&](int y) {
+        unsigned char *d = dst.row(y);
+        for (int x = 0; x < width; x++)
+            d[x] = (d[x] == CANNY_STRONG) ? 255 : 0;
+    });
+}
+
+// ===================== BMP文件读写层 =====================
+// 所有基于文件路径的函数共用这一层：输入文件只读映射后直接以ImageView暴露各行，
+// 输出文件预先分配好大小再映射，计算核心直接把结果写进文件页，不再逐行fread/fwrite。
+// ImageView始终是“从上到下”的视角，自下而上存储的BMP用负的行跨度表示，无需翻转复制。
+
+// 宽、高的上限：超过时在做任何尺寸运算之前拒绝
+const int BMP_MAX_DIMENSION = 65535;
+
+// BMP每行按4字节对齐
+inline size_t bmp_row_size(int width, int channels)
+{
+    return ((size_t)width * channels + 3) / 4 * 4;
+}
+
+// 生成输出BMP文件头：1通道输出附带256级灰度调色板，像素数据一律自下而上存储
+void make_bmp_header(int width, int height, int channels, const fileInfo *like,
+                     fileHeader &fh, fileInfo &fi)
+{
+    memset(&fh, 0, sizeof(fileHeader));
+    memset(&fi, 0, sizeof(fileInfo));
+    if (like)
+    {
+        // 保留输入文件的分辨率等信息
+        fi.biXPixPerMeter = like->biXPixPerMeter;
+        fi.biYPixPerMeter = like->biYPixPerMeter;
+    }
+    fi.biSize = sizeof(fileInfo);
+    fi.biWidth = width;
+    fi.biHeight = height;
+    fi.biPlanes = 1;
+    fi.biBitCount = channels * 8;
+    fi.biCompression = 0;
+    // bfSize与biSizeImage都是32位字段，写不下的图像无法保存为BMP
+    uint64_t imageSize = (uint64_t)bmp_row_size(width, channels) * height;
+    if (imageSize > UINT32_MAX - (sizeof(fileHeader) + sizeof(fileInfo) + 256 * sizeof(rgbq)))
+    {
+        throw std::runtime_error("输出图像过大，超出BMP文件的大小上限");
+    }
+    fi.biSizeImage = (uint32_t)imageSize;
+    fi.biClrUsed = (channels == 1) ? 256 : 0;
+    fi.biClrImportant = (channels == 1) ? 256 : 0;
+
+    fh.bfType[0] = 'B';
+    fh.bfType[1] = 'M';
+    fh.bfOffBits = sizeof(fileHeader) + sizeof(fileInfo) + ((channels == 1) ? 256 * sizeof(rgbq) : 0);
+    fh.bfSize = fh.bfOffBits + fi.biSizeImage;
+}
+
+// 检查BMP文件头，返回错误信息（不含路径），合法时返回NULL
+const char *check_bmp_header(const fileHeader &fh, const fileInfo &fi, size_t fileSize)
+{
+    if (fh.bfType[0] != 'B' || fh.bfType[1] != 'M' || fi.biWidth <= 0 || fi.biHeight == 0)
+    {
+        return "不是有效的BMP文件: ";
+    }
+    // 先按有符号数比较高度，INT_MIN取绝对值是未定义行为
+    if (fi.biWidth > BMP_MAX_DIMENSION || fi.biHeight > BMP_MAX_DIMENSION || fi.biHeight < -BMP_MAX_DIMENSION)
+    {
+        return "BMP图像尺寸超出支持范围: ";
+    }
+    if (fi.biCompression != 0 || (fi.biBitCount != 24 && fi.biBitCount != 8))
+    {
+        return "仅支持未压缩的24位或8位BMP文件: ";
+    }
+    uint64_t dataSize = (uint64_t)bmp_row_size(fi.biWidth, fi.biBitCount / 8) * (uint64_t)abs(fi.biHeight);
+    if ((uint64_t)fh.bfOffBits + dataSize > fileSize)
+    {
+        return "BMP文件数据不完整: ";
+    }
+    return NULL;
+}
+
+// 整个BMP文件在内存中时，像素数据的视图（从上到下，自下而上存储时行跨度为负）
+ImageView bmp_pixels_view(unsigned char *file, const fileHeader &fh, const fileInfo &fi)
+{
+    int width = fi.biWidth, height = abs(fi.biHeight), channels = fi.biBitCount / 8;
+    size_t rowSize = bmp_row_size(width, channels);
+    unsigned char *pixels = file + fh.bfOffBits;
+    if (fi.biHeight > 0)
+    {
+        // 自下而上存储：最上面一行位于数据末尾
+        return ImageView{pixels + (size_t)(height - 1) * rowSize, width, height, -(ptrdiff_t)rowSize, channels};
+    }
+    return ImageView{pixels, width, height, (ptrdiff_t)rowSize, channels};
+}
+
+// 完整读写len字节，处理被信号打断或短读写的情况
+static bool pread_full(int fd, void *buf, size_t len, off_t offset)
+{
+    unsigned char *p = (unsigned char *)buf;
+    while (len > 0)
+    {
+        ssize_t n = pread(fd, p, len, offset);
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+static bool pwrite_full(int fd, const void *buf, size_t len, off_t offset)
+{
+    const unsigned char *p = (const unsigned char *)buf;
+    while (len > 0)
+    {
+        ssize_t n = pwrite(fd, p, len, offset);
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+// 把文件头、信息头以及（1通道时的）灰度调色板写入out，共fh.bfOffBits字节
+void write_bmp_head(const fileHeader &fh, const fileInfo &fi, unsigned char *out)
+{
+    memcpy(out, &fh, sizeof(fileHeader));
+    memcpy(out + sizeof(fileHeader), &fi, sizeof(fileInfo));
+    if (fi.biBitCount == 8)
+    {
+        rgbq *palette = (rgbq *)(out + sizeof(fileHeader) + sizeof(fileInfo));
+        for (int i = 0; i < 256; i++)
+        {
+            palette[i].rgbRed = palette[i].rgbGreen = palette[i].rgbBlue = i;
+            palette[i].rgbReserved = 0;
+        }
+    }
+}
+
+// 只读映射的BMP输入文件。
+// map为false时不做映射，只能用read_rows()按条带读取，用于内存受限的流式处理
+class BmpReader
+{
+public:
+    explicit BmpReader(const std::string &path, bool map = true) : path_(path)
+    {
+        fd_ = open(path.c_str(), O_RDONLY);
+        if (fd_ < 0)
+        {
+            throw std::runtime_error("无法打开输入文件: " + path);
+        }
+        struct stat st;
+        if (fstat(fd_, &st) != 0 || st.st_size < (off_t)(sizeof(fileHeader) + sizeof(fileInfo)))
+        {
+            fail("不是有效的BMP文件: ");
+        }
+        size_ = st.st_size;
+        if (map)
+        {
+            base_ = (unsigned char *)mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+            if (base_ == MAP_FAILED)
+            {
+                base_ = NULL;
+                fail("无法映射输入文件: ");
+            }
+            memcpy(&fh_, base_, sizeof(fileHeader));
+            memcpy(&fi_, base_ + sizeof(fileHeader), sizeof(fileInfo));
+        }
+        else if (!pread_full(fd_, &fh_, sizeof(fileHeader), 0) ||
+                 !pread_full(fd_, &fi_, sizeof(fileInfo), sizeof(fileHeader)))
+        {
+            fail("读取输入文件失败: ");
+        }
+
+        const char *error = check_bmp_header(fh_, fi_, size_);
+        if (error)
+        {
+            fail(error);
+        }
+        channels_ = fi_.biBitCount / 8;
+        width_ = fi_.biWidth;
+        height_ = abs(fi_.biHeight);
+        rowSize_ = bmp_row_size(width_, channels_);
+        // 提前让内核异步预读，与随后的计算重叠
+        if (base_)
+            madvise(base_, size_, MADV_WILLNEED);
+    }
+
+    ~BmpReader() { release(); }
+
+    BmpReader(const BmpReader &) = delete;
+    BmpReader &operator=(const BmpReader &) = delete;
+
+    const fileHeader &header() const { return fh_; }
+    const fileInfo &info() const { return fi_; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int channels() const { return channels_; }
+    int bitCount() const { return fi_.biBitCount; }
+    size_t row_size() const { return rowSize_; }
+
+    // 把映射的整个文件读入内存：每页访问一次，之后的计算不再因缺页等待磁盘。
+    // 单独调用是为了把读盘时间与计算时间分开统计，不调用时由计算过程按需缺页读入
+    void load() const
+    {
+        if (!base_)
+            return;
+        long page = sysconf(_SC_PAGESIZE);
+        long pages = (long)((size_ + page - 1) / page);
+        unsigned sum = 0;
+#pragma omp parallel for reduction(+ : sum)
+        for (long i = 0; i < pages; i++)
+            sum += base_[i * page];
+        volatile unsigned sink = sum; // 防止读操作被优化掉
+        (void)sink;
+    }
+
+    // 像素数据的原地视图（从上到下），仅映射模式可用
+    ImageView view() const
+    {
+        return bmp_pixels_view(base_, fh_, fi_);
+    }
+
+    // 把第y0到y1-1行读入buf并返回其视图（从上到下）。这些行在文件中是连续的一段，一次pread读完
+    ImageView read_rows(int y0, int y1, std::vector<unsigned char> &buf) const
+    {
+        int rows = y1 - y0;
+        bool bottomUp = fi_.biHeight > 0;
+        int fileRow = bottomUp ? height_ - y1 : y0;
+        buf.resize((size_t)rows * rowSize_);
+        if (!pread_full(fd_, buf.data(), buf.size(), (off_t)fh_.bfOffBits + (off_t)fileRow * rowSize_))
+        {
+            throw std::runtime_error("读取输入文件失败: " + path_);
+        }
+        if (bottomUp)
+        {
+            return ImageView{buf.data() + (size_t)(rows - 1) * rowSize_, width_, rows, -(ptrdiff_t)rowSize_, channels_};
+        }
+        return ImageView{buf.data(), width_, rows, (ptrdiff_t)rowSize_, channels_};
+    }
+
+private:
+    void release()
+    {
+        if (base_)
+            munmap(base_, size_);
+        if (fd_ >= 0)
+            ::close(fd_);
+        base_ = NULL;
+        fd_ = -1;
+    }
+
+    void fail(const char *msg)
+    {
+        release();
+        throw std::runtime_error(msg + path_);
+    }
+
+    std::string path_;
+    int fd_ = -1;
+    unsigned char *base_ = NULL;
+    size_t size_ = 0;
+    fileHeader fh_;
+    fileInfo fi_;
+    int width_ = 0, height_ = 0, channels_ = 0;
+    size_t rowSize_ = 0;
+};
+
+// 预先分配大小并映射的BMP输出文件。
+// 若文件系统不支持共享映射，则退化为内存缓冲，close()时按行块并行pwrite到计算好的偏移。
+// map为false时既不映射也不缓冲，由调用者用strip_view()/write_rows()按条带写出
+class BmpWriter
+{
+public:
+    BmpWriter(const std::string &path, int width, int height, int channels, const fileInfo *like = NULL,
+              bool map = true)
+        : path_(path), width_(width), height_(height), channels_(channels)
+    {
+        fileHeader fh;
+        fileInfo fi;
+        make_bmp_header(width, height, channels, like, fh, fi);
+        rowSize_ = bmp_row_size(width, channels);
+        offBits_ = fh.bfOffBits;
+        size_ = fh.bfSize;
+
+        fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0)
+        {
+            throw std::runtime_error("无法创建输出文件: " + path);
+        }
+        if (ftruncate(fd_, size_) != 0)
+        {
+            release();
+            throw std::runtime_error("无法分配输出文件空间: " + path);
+        }
+
+        std::vector<unsigned char> head(offBits_);
+        write_bmp_head(fh, fi, head.data());
+
+        if (!map)
+        {
+            streaming_ = true;
+            if (!pwrite_full(fd_, head.data(), offBits_, 0))
+            {
+                release();
+                throw std::runtime_error("写入输出文件失败: " + path);
+            }
+            return;
+        }
+
+        base_ = (unsigned char *)mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (base_ == MAP_FAILED)
+        {
+            base_ = NULL;
+            buffer_.assign(size_, 0);
+            pixels_ = buffer_.data() + offBits_;
+        }
+        else
+        {
+            pixels_ = base_ + offBits_;
+        }
+        memcpy(pixels_ - offBits_, head.data(), offBits_);
+    }
+
+    ~BmpWriter() { release(); }
+
+    BmpWriter(const BmpWriter &) = delete;
+    BmpWriter &operator=(const BmpWriter &) = delete;
+
+    // 输出像素的视图（从上到下，文件中自下而上存储）
+    ImageView view() const
+    {
+        return ImageView{pixels_ + (size_t)(height_ - 1) * rowSize_, width_, height_,
+                         -(ptrdiff_t)rowSize_, channels_};
+    }
+
+    size_t row_size() const { return rowSize_; }
+
+    // 第y0到y1-1行的条带缓冲视图（从上到下）。buf按文件中的行序与对齐存放，可以直接交给write_rows()
+    ImageView strip_view(int y0, int y1, std::vector<unsigned char> &buf) const
+    {
+        int rows = y1 - y0;
+        buf.resize((size_t)rows * rowSize_);
+        return ImageView{buf.data() + (size_t)(rows - 1) * rowSize_, width_, rows, -(ptrdiff_t)rowSize_, channels_};
+    }
+
+    // 把strip_view()得到的第y0到y1-1行写到文件中对应的位置
+    void write_rows(int y0, int y1, const std::vector<unsigned char> &buf)
+    {
+        size_t offset = offBits_ + (size_t)(height_ - y1) * rowSize_;
+        if (!pwrite_full(fd_, buf.data(), (size_t)(y1 - y0) * rowSize_, offset))
+        {
+            release();
+            throw std::runtime_error("写入输出文件失败: " + path_);
+        }
+    }
+
+    // 完成写入：缓冲模式下并行pwrite，随后释放映射与文件描述符
+    void close()
+    {
+        if (fd_ < 0)
+            return;
+        if (!base_ && !streaming_)
+        {
+            const int blockRows = 256;
+            int blocks = (height_ + blockRows - 1) / blockRows;
+            bool ok = pwrite(fd_, buffer_.data(), offBits_, 0) == (ssize_t)offBits_;
+#pragma omp parallel for reduction(&& : ok)
+            for (int b = 0; b < blocks; b++)
+            {
+                size_t first = (size_t)b * blockRows * rowSize_;
+                size_t len = (size_t)std::min(blockRows, height_ - b * blockRows) * rowSize_;
+                ok = ok && pwrite(fd_, pixels_ + first, len, offBits_ + first) == (ssize_t)len;
+            }
+            if (!ok)
+            {
+                release();
+                throw std::runtime_error("写入输出文件失败: " + path_);
+            }
+        }
+        release();
+    }
+
+private:
+    void release()
+    {
+        if (base_)
+            munmap(base_, size_);
+        if (fd_ >= 0)
+            ::close(fd_);
+        base_ = NULL;
+        fd_ = -1;
+    }
+
+    std::string path_;
+    int width_, height_, channels_;
+    size_t rowSize_ = 0;
+    size_t offBits_ = 0, size_ = 0;
+    int fd_ = -1;
+    bool streaming_ = false;
+    unsigned char *base_ = NULL;
+    unsigned char *pixels_ = NULL;
+    std::vector<unsigned char> buffer_;
+};
+
+// 检查输入是否为24位图像
+void require_24bit(const BmpReader &in, const char *msg)
+{
+    if (in.bitCount() != 24)
+    {
+        throw std::runtime_error(msg);
+    }
+}
+
+// ===================== 硬件性能计数器 =====================
+// set_perf_counters(True)后，各处理函数的计算阶段用perf_event_open在每个OpenMP线程上各开一组计数器
+// （只统计用户态），结束时逐线程读出并求和，随计时记录一起返回。容器内无法运行perf时也可用，
+// 只要perf_event_paranoid不高于2。计数包含工作线程在并行区域之间自旋等待的部分
+
+static std::atomic<bool> perf_counters_enabled(false);
+
+enum PerfCounterId
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTER_COUNT
+};
+
+static const char *const perf_counter_names[PERF_COUNTER_COUNT] = {"cycles", "instructions", "llc_misses",
+                                                                   "branch_misses"};
+
+// 一组计数值，-1表示该计数器不可用（例如虚拟机没有暴露LLC事件）
+struct PerfCounts
+{
+    long long value[PERF_COUNTER_COUNT] = {-1, -1, -1, -1};
+};
+
+static int open_perf_counter(int id)
+{
+    static const uint64_t configs[PERF_COUNTER_COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                         PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[id];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// 在调用线程的OpenMP线程组的每个线程上各开一组计数器。线程池中的线程在本线程随后的并行区域里
+// 按编号复用，所以第t组计数器统计的就是各个并行区域里第t号线程的执行（尽力而为）
+class PerfCounterScope
+{
+public:
+    PerfCounterScope() : threads_(omp_get_max_threads()), fds_((size_t)threads_ * PERF_COUNTER_COUNT, -1)
+    {
+#pragma omp parallel num_threads(threads_)
+        {
+            int *fds = &fds_[(size_t)omp_get_thread_num() * PERF_COUNTER_COUNT];
+            for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+            {
+                fds[i] = open_perf_counter(i);
+                if (fds[i] >= 0)
+                {
+                    ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+                    ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+                }
+            }
+        }
+    }
+
+    ~PerfCounterScope() { close_all(); }
+
+    PerfCounterScope(const PerfCounterScope &) = delete;
+    PerfCounterScope &operator=(const PerfCounterScope &) = delete;
+
+    // 停止计数并读出每个线程的计数；计数器被复用（多路分时）时按实际运行时间比例放大
+    std::vector<PerfCounts> stop()
+    {
+        std::vector<PerfCounts> counts(threads_);
+#pragma omp parallel num_threads(threads_)
+        {
+            int t = omp_get_thread_num();
+            int *fds = &fds_[(size_t)t * PERF_COUNTER_COUNT];
+            for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+            {
+                if (fds[i] < 0)
+                    continue;
+                ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+                uint64_t data[3]; // 计数值、启用时间、实际运行时间
+                if (read(fds[i], data, sizeof(data)) == (ssize_t)sizeof(data) && data[2] > 0)
+                    counts[t].value[i] = (long long)((double)data[0] * data[1] / data[2]);
+            }
+        }
+        close_all();
+        return counts;
+    }
+
+private:
+    void close_all()
+    {
+        for (int &fd : fds_)
+        {
+            if (fd >= 0)
+                ::close(fd);
+            fd = -1;
+        }
+    }
+
+    int threads_;
+    std::vector<int> fds_;
+};
+
+// 各线程计数之和，任一线程上不可用的计数器记为-1
+PerfCounts sum_perf_counts(const std::vector<PerfCounts> &counts)
+{
+    PerfCounts sum;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+    {
+        long long total = 0;
+        for (const PerfCounts &c : counts)
+        {
+            if (c.value[i] < 0)
+            {
+                total = -1;
+                break;
+            }
+            total += c.value[i];
+        }
+        sum.value[i] = counts.empty() ? -1 : total;
+    }
+    return sum;
+}
+
+void set_perf_counters(bool enabled)
+{
+    if (enabled)
+    {
+        int fd = open_perf_counter(PERF_CYCLES);
+        if (fd < 0)
+        {
+            throw std::runtime_error(std::string("无法打开硬件性能计数器（检查/proc/sys/kernel/perf_event_paranoid）: ") +
+                                     strerror(errno));
+        }
+        ::close(fd);
+    }
+    perf_counters_enabled = enabled;
+}
+
+bool get_perf_counters()
+{
+    return perf_counters_enabled.load();
+}
+
+// ===================== 分阶段计时 =====================
+// 各处理函数返回的计时记录，时间单位为秒：header为打开输入并解析文件头，read为把输入像素读入内存，
+// allocation为创建输出文件并分配空间，compute为计算，write为写出并关闭输出文件，total为整个调用。
+// 所有函数都从调用开始计时，各阶段之和等于total（拼接函数的解码计入read，不单独统计header）
+struct Timing
+{
+    double header = 0;
+    double read = 0;
+    double allocation = 0;
+    double compute = 0;
+    double write = 0;
+    double total = 0;
+    long long pixels = 0; // 输出图像的像素数
+    double bytes = 0;     // 读入与写出的像素数据总字节数
+    // 计算阶段的硬件计数，未开启set_perf_counters时为空
+    std::vector<PerfCounts> thread_counters;
+    PerfCounts counters;
+
+    double mb_per_second() const { return total > 0 ? bytes / (1024.0 * 1024.0) / total : 0.0; }
+};
+
+// 开启了硬件计数器时，在计算阶段前后各调用一次start()/stop()
+class ComputeCounters
+{
+public:
+    void start()
+    {
+        if (perf_counters_enabled)
+            scope_.reset(new PerfCounterScope());
+    }
+
+    void stop(Timing &timing)
+    {
+        if (!scope_)
+            return;
+        timing.thread_counters = scope_->stop();
+        timing.counters = sum_perf_counts(timing.thread_counters);
+        scope_.reset();
+    }
+
+private:
+    std::unique_ptr<PerfCounterScope> scope_;
+};
+
+// 按顺序记录各阶段：mark()把上一次mark()以来的时间计入给定阶段
+class PhaseTimer
+{
+public:
+    explicit PhaseTimer(Timing &timing) : timing_(timing), start_(omp_get_wtime()), last_(start_) {}
+
+    void mark(double &phase)
+    {
+        double now = omp_get_wtime();
+        phase += now - last_;
+        last_ = now;
+    }
+
+    Timing finish()
+    {
+        timing_.total = omp_get_wtime() - start_;
+        return timing_;
+    }
+
+private:
+    Timing &timing_;
+    double start_, last_;
+};
+
+// 文件到文件的一次处理：读入24位BMP，用compute(src, dst)算出out_channels通道的输出并写出，各阶段分别计时
+template <typename Compute>
+Timing run_file_kernel(const std::string &input, const std::string &output, const char *msg, int out_channels,
+                       Compute compute)
+{
+    Timing timing;
+    PhaseTimer timer(timing);
+
+    BmpReader in(input);
+    require_24bit(in, msg);
+    timer.mark(timing.header);
+
+    in.load();
+    timer.mark(timing.read);
+
+    BmpWriter out(output, in.width(), in.height(), out_channels, &in.info());
+    ComputeCounters counters;
+    counters.start();
+    timer.mark(timing.allocation);
+
+    compute(in.view(), out.view());
+    timer.mark(timing.compute);
+    counters.stop(timing);
+
+    out.close();
+    timer.mark(timing.write);
+
+    timing.pixels = (long long)in.width() * in.height();
+    timing.bytes = (double)timing.pixels * (in.channels() + out_channels);
+    return timer.finish();
+}
+
+// 由Python传入的色调调整列表构造查找表，按顺序复合，例如[("levels", 16, 235), ("gamma", 0.8)]。
+// 支持的调整（v为0..255的像素值）：
+//   ("brightness", delta)                      v + delta
+//   ("contrast", factor[, pivot])              (v - pivot) * factor + pivot，pivot默认127.5
+//   ("gamma", gamma)                           255 * (v / 255) ^ gamma，gamma小于1变亮
+//   ("levels", in_black, in_white[, gamma[, out_black, out_white]])
+//                                              把[in_black, in_white]线性拉伸到[out_black, out_white]，
+//                                              中间调按1 / gamma次幂调整（gamma大于1变亮，同Photoshop色阶）
+//   ("curve", [(x, y), ...][, channel])        经过各控制点的折线，两端之外取端点的y
+//   ("table", values[, channel])               任意映射，values为256个值，或3x256（B、G、R各一行）
+// channel为"b"、"g"或"r"时只调整该通道，省略时调整全部通道
+PointLut parse_point_ops(const std::vector<std::vector<py::object>> &ops)
+{
+    PointLut lut;
+    for (const auto &op : ops)
+    {
+        if (op.empty())
+        {
+            throw std::runtime_error("色调调整不能为空");
+        }
+        std::string name = op[0].cast<std::string>();
+        auto expect_args = [&](size_t min_args, size_t max_args) {
+            if (op.size() - 1 < min_args || op.size() - 1 > max_args)
+            {
+                throw std::runtime_error("色调调整参数数量错误: " + name);
+            }
+        };
+        auto channel_arg = [&](size_t i) {
+            if (op.size() <= i)
+                return -1;
+            std::string c = op[i].cast<std::string>();
+            if (c == "b")
+                return 0;
+            if (c == "g")
+                return 1;
+            if (c == "r")
+                return 2;
+            throw std::runtime_error("通道必须为\"b\"、\"g\"或\"r\": " + c);
+        };
+
+        if (name == "brightness")
+        {
+            expect_args(1, 1);
+            double delta = op[1].cast<double>();
+            lut.then(-1, [=](double v) { return v + delta; });
+        }
+        else if (name == "contrast")
+        {
+            expect_args(1, 2);
+            double factor = op[1].cast<double>();
+            double pivot = op.size() > 2 ? op[2].cast<double>() : 127.5;
+            lut.then(-1, [=](double v) { return (v - pivot) * factor + pivot; });
+        }
+        else if (name == "gamma")
+        {
+            expect_args(1, 1);
+            double gamma = op[1].cast<double>();
+            if (gamma <= 0)
+            {
+                throw std::runtime_error("gamma必须大于0");
+            }
+            lut.then(-1, [=](double v) { return 255.0 * pow(v / 255.0, gamma); });
+        }
+        else if (name == "levels")
+        {
+            expect_args(2, 5);
+            if (op.size() == 5)
+            {
+                throw std::runtime_error("levels的out_black与out_white需要同时给出");
+            }
+            double in_black = op[1].cast<double>(), in_white = op[2].cast<double>();
+            double gamma = op.size() > 3 ? op[3].cast<double>() : 1.0;
+            double out_black = op.size() > 4 ? op[4].cast<double>() : 0.0;
+            double out_white = op.size() > 5 ? op[5].cast<double>() : 255.0;
+            if (in_black >= in_white)
+            {
+                throw std::runtime_error("levels要求in_black < in_white");
+            }
+            if (gamma <= 0)
+            {
+                throw std::runtime_error("gamma必须大于0");
+            }
+            lut.then(-1, [=](double v) {
+                double t = std::min(std::max((v - in_black) / (in_white - in_black), 0.0), 1.0);
+                return out_black + pow(t, 1.0 / gamma) * (out_white - out_black);
+            });
+        }
+        else if (name == "curve")
+        {
+            expect_args(1, 2);
+            std::vector<std::pair<double, double>> points = op[1].cast<std::vector<std::pair<double, double>>>();
+            std::sort(points.begin(), points.end());
+            if (points.size() < 2)
+            {
+                throw std::runtime_error("曲线至少需要两个控制点");
+            }
+            for (size_t i = 1; i < points.size(); i++)
+            {
+                if (points[i].first == points[i - 1].first)
+                {
+                    throw std::runtime_error("曲线控制点的x不能重复");
+                }
+            }
+            lut.then(channel_arg(2), [&](double v) {
+                if (v <= points.front().first)
+                    return points.front().second;
+                if (v >= points.back().first)
+                    return points.back().second;
+                // 第一个x大于v的控制点，v落在它与前一个控制点之间
+                size_t i = std::upper_bound(points.begin(), points.end(), v,
+                                            [](double x, const std::pair<double, double> &p) { return x < p.first; }) -
+                           points.begin();
+                const auto &a = points[i - 1], &b = points[i];
+                return a.second + (v - a.first) * (b.second - a.second) / (b.first - a.first);
+            });
+        }
+        else if (name == "table")
+        {
+            expect_args(1, 2);
+            std::vector<std::vector<double>> rows;
+            if (py::len(op[1]) == 256)
+                rows.push_back(op[1].cast<std::vector<double>>());
+            else
+                rows = op[1].cast<std::vector<std::vector<double>>>();
+            bool perChannel = rows.size() == 3 && !(rows[0] == rows[1] && rows[0] == rows[2]);
+            if ((rows.size() != 1 && rows.size() != 3) || rows[0].size() != 256 ||
+                (rows.size() == 3 && (rows[1].size() != 256 || rows[2].size() != 256)))
+            {
+                throw std::runtime_error("查找表必须为256个值或3x256");
+            }
+            if (perChannel && op.size() > 2)
+            {
+                throw std::runtime_error("3x256的查找表不能再指定通道");
+            }
+            if (perChannel)
+            {
+                for (int c = 0; c < 3; c++)
+                    lut.then(c, [&](double v) { return rows[c][(int)v]; });
+            }
+            else
+            {
+                lut.then(channel_arg(2), [&](double v) { return rows[0][(int)v]; });
+            }
+        }
+        else
+        {
+            throw std::runtime_error("未知的色调调整: " + name);
+        }
+    }
+    return lut;
+}
+
+// 封装为Python可调用的函数。同一份模板按执行策略实例化：默认策略绑定为convert_to_grayscale等，
+// SerialPolicy绑定为convert_to_grayscale_serial等串行版本，两者的I/O、计时与计算代码完全相同
+template <typename Policy = OmpRuntimePolicy>
+Timing convert_to_grayscale_py(const std::string &input, const std::string &output)
+{
+    return run_file_kernel(input, output, "仅支持24位RGB图像进行灰度转换", 1,
+                           [](const ImageView &src, const ImageView &dst) { grayscale_kernel<Policy>(src, dst); });
+}
+
+template <typename Policy = OmpRuntimePolicy>
+Timing convert_to_binary_py(const std::string &input, const std::string &output, int threshold)
+{
+    return run_file_kernel(input, output, "仅支持24位RGB图像进行二值化", 1,
+                           [&](const ImageView &src, const ImageView &dst) {
+                               binary_kernel<Policy>(src, dst, threshold);
+                           });
+}
+
+template <typename Policy = OmpRuntimePolicy>
+Timing adjust_brightness_py(const std::string &input, const std::string &output, int delta)
+{
+    return run_file_kernel(input, output, "仅支持24位RGB图像亮度调整", 3,
+                           [&](const ImageView &src, const ImageView &dst) {
+                               brightness_kernel<Policy>(src, dst, delta);
+                           });
+}
+
+template <typename Policy = OmpRuntimePolicy>
+Timing apply_gaussian_blur_py(const std::string &input, const std::string &output, int kernel_size, float sigma,
+                              const std::string &method)
+{
+    GaussianMethod gaussian_method = parse_gaussian_method(method);
+    return run_file_kernel(input, output, "仅支持24位RGB图像进行高斯模糊", 3,
+                           [&](const ImageView &src, const ImageView &dst) {
+                               gaussian_blur_kernel<Policy>(src, dst, kernel_size, sigma, gaussian_method);
+                           });
+}
+
+template <typename Policy = OmpRuntimePolicy>
+Timing apply_custom_convolution_py(const std::string &input, const std::string &output,
+                                   const std::vector<std::vector<float>> &kernel_vec, float divisor,
+                                   const std::string &method)
+{
+    ConvolutionMethod convolution_method = parse_convolution_method(method);
+    return run_file_kernel(input, output, "仅支持24位RGB图像进行卷积操作", 3,
+                           [&](const ImageView &src, const ImageView &dst) {
+                               custom_convolution_kernel<Policy>(src, dst, kernel_vec, divisor, convolution_method);
+                           });
+}
+
+template <typename Policy = OmpRuntimePolicy>
+Timing apply_sobel_edge_detection_py(const std::string &input, const std::string &output, bool single_channel)
+{
+    // single_channel时输出8位灰度BMP，输出字节数只有24位的三分之一
+    return run_file_kernel(input, output, "仅支持24位RGB图像进行Sobel边缘检测", single_channel ? 1 : 3,
+                           [](const ImageView &src, const ImageView &dst) { sobel_kernel<Policy>(src, dst); });
+}
+
+template <typename Policy = OmpRuntimePolicy>
+Timing apply_canny_edge_detection_py(const std::string &input, const std::string &output, double low_threshold,
+                                     double high_threshold, int kernel_size, float sigma, bool l2_gradient)
+{
+    return run_file_kernel(input, output, "仅支持24位RGB图像进行Canny边缘检测", 1,
+                           [&](const ImageView &src, const ImageView &dst) {
+                               canny_kernel<Policy>(src, dst, low_threshold, high_threshold, kernel_size, sigma,
+                                                    l2_gradient);
+                           });
+}
+
+// 自动阈值的结果转为字典：threshold为第一个阈值，thresholds为全部阈值，histogram为256级亮度直方图
+py::dict auto_threshold_dict(const AutoThresholdResult &result)
+{
+    py::dict d;
+    d["threshold"] = result.thresholds[0];
+    d["thresholds"] = result.thresholds;
+    py::array_t<long long> histogram(256);
+    std::copy(result.histogram.begin(), result.histogram.end(), histogram.mutable_data());
+    d["histogram"] = histogram;
+    return d;
+}
+
+// 自动阈值二值化，除阈值与直方图外还返回计时记录timing
+template <typename Policy = OmpRuntimePolicy>
+py::dict convert_to_binary_auto_py(const std::string &input, const std::string &output, const std::string &method,
+                                   int classes)
+{
+    ThresholdMethod threshold_method = parse_threshold_method(method);
+    AutoThresholdResult result;
+    Timing timing;
+    {
+        py::gil_scoped_release release;
+        timing = run_file_kernel(input, output, "仅支持24位RGB图像进行二值化", 1,
+                                 [&](const ImageView &src, const ImageView &dst) {
+                                     result = auto_binary_kernel<Policy>(src, dst, threshold_method, classes);
+                                 });
+    }
+    py::dict d = auto_threshold_dict(result);
+    d["timing"] = timing;
+    return d;
+}
+
+// 查找表点运算：ops同parse_point_ops，全部调整复合成一张表后一遍写出
+template <typename Policy = OmpRuntimePolicy>
+Timing apply_point_ops_py(const std::string &input, const std::string &output,
+                          const std::vector<std::vector<py::object>> &ops)
+{
+    PointLut lut = parse_point_ops(ops);
+    py::gil_scoped_release release;
+    return run_file_kernel(input, output, "仅支持24位RGB图像进行色调调整", 3,
+                           [&](const ImageView &src, const ImageView &dst) { lut_kernel<Policy>(src, dst, lut); });
+}
+
+// 由Python传入的算子列表构造流水线，例如[("gaussian", 5, 1.2), ("sobel",)]
+// 支持的算子：("grayscale",) ("binary", threshold) ("brightness", delta) ("point_ops", [调整, ...])
+//            ("gaussian", kernel_size, sigma) ("sobel",) ("convolution", kernel[, divisor])
+Pipeline parse_pipeline(const std::vector<std::vector<py::object>> &ops)
+{
+    Pipeline pipeline;
+    for (const auto &op : ops)
+    {
+        if (op.empty())
+        {
+            throw std::runtime_error("流水线算子不能为空");
+        }
+        std::string name = op[0].cast<std::string>();
+        auto expect_args = [&](size_t min_args, size_t max_args) {
+            if (op.size() - 1 < min_args || op.size() - 1 > max_args)
+            {
+                throw std::runtime_error("流水线算子参数数量错误: " + name);
+            }
+        };
+
+        if (name == "grayscale")
+        {
+            expect_args(0, 0);
+            pipeline.add(std::make_shared<GrayscaleStage>());
+        }
+        else if (name == "binary")
+        {
+            expect_args(1, 1);
+            pipeline.add(std::make_shared<BinaryStage>(op[1].cast<int>()));
+        }
+        else if (name == "brightness")
+        {
+            expect_args(1, 1);
+            pipeline.add(std::make_shared<BrightnessStage>(op[1].cast<int>()));
+        }
+        else if (name == "point_ops")
+        {
+            expect_args(1, 1);
+            pipeline.add(std::make_shared<LutStage>(parse_point_ops(op[1].cast<std::vector<std::vector<py::object>>>())));
+        }
+        else if (name == "gaussian")
+        {
+            expect_args(2, 2);
+            pipeline.add(std::make_shared<GaussianStage>(op[1].cast<int>(), op[2].cast<float>()));
+        }
+        else if (name == "sobel")
+        {
+            expect_args(0, 0);
+            pipeline.add(std::make_shared<SobelStage>());
+        }
+        else if (name == "convolution")
+        {
+            expect_args(1, 2);
+            float divisor = (op.size() > 2) ? op[2].cast<float>() : 1.0f;
+            pipeline.add(std::make_shared<ConvolutionStage>(op[1].cast<std::vector<std::vector<float>>>(), divisor));
+        }
+        else
+        {
+            throw std::runtime_error("未知的流水线算子: " + name);
+        }
+    }
+    return pipeline;
+}
+
+// 流式执行：每次pread一条水平条带（上下各多读total_halo()行），并行算完后立即pwrite写出，再读下一条。
+// 常驻内存是一条带的输入与输出缓冲，加上每个线程的图块缓冲与算子私有缓冲（Pipeline::thread_bytes），
+// 都不随图像高度增长。budget先扣除线程缓冲与上下邻域行，剩下的决定条带高度（至少一行）；
+// budget小于线程缓冲时仍按一行的条带执行，实际占用会超过budget。
+// 各条带的读、写时间分别累加到timing.read与timing.write；计算时间由调用方用整段耗时减去这两项得到，
+// 这样条带之间的循环开销也计入计算，各阶段之和仍等于total
+void run_pipeline_streaming(const Pipeline &pipeline, const BmpReader &in, BmpWriter &out, size_t budget,
+                            Timing &timing)
+{
+    int height = in.height(), halo = pipeline.total_halo();
+    size_t inRow = in.row_size(), outRow = out.row_size();
+    size_t fixed = 2 * (size_t)halo * inRow +
+                   pipeline.thread_bytes(in.width(), in.channels()) * OmpRuntimePolicy::concurrency();
+    int stripRows = 1;
+    if (budget > fixed)
+    {
+        stripRows = (int)std::min((budget - fixed) / (inRow + outRow), (size_t)height);
+        stripRows = std::max(stripRows, 1);
+    }
+
+    std::vector<unsigned char> inBuf, outBuf;
+    for (int y0 = 0; y0 < height; y0 += stripRows)
+    {
+        int y1 = std::min(y0 + stripRows, height);
+        int sy0 = std::max(y0 - halo, 0), sy1 = std::min(y1 + halo, height);
+        double t0 = omp_get_wtime();
+        ImageView src = in.read_rows(sy0, sy1, inBuf);
+        ImageView dst = out.strip_view(y0, y1, outBuf);
+        timing.read += omp_get_wtime() - t0;
+        pipeline.run_band(src, sy0, dst, y0, height);
+        double t2 = omp_get_wtime();
+        out.write_rows(y0, y1, outBuf);
+        timing.write += omp_get_wtime() - t2;
+    }
+}
+
+// 融合流水线：整条算子链按图块一次完成，最终结果为单通道时输出8位灰度BMP。
+// memory_budget_mb大于0时按条带流式处理，用于超过内存的大图
+Timing run_pipeline_py(const std::string &input, const std::string &output,
+                       const std::vector<std::vector<py::object>> &ops, double memory_budget_mb)
+{
+    Timing timing;
+    PhaseTimer timer(timing);
+
+    Pipeline pipeline = parse_pipeline(ops);
+    bool streaming = memory_budget_mb > 0;
+    py::gil_scoped_release release;
+    BmpReader in(input, !streaming);
+    timer.mark(timing.header);
+    int out_channels = pipeline.output_channels(in.channels());
+    BmpWriter out(output, in.width(), in.height(), out_channels, &in.info(), !streaming);
+    timer.mark(timing.allocation);
+
+    ComputeCounters counters;
+    if (streaming)
+    {
+        counters.start();
+        // 条带内部的读、写各自累加，整段耗时减去读写即为计算；收尾的关闭文件随后计入写出
+        run_pipeline_streaming(pipeline, in, out, (size_t)(memory_budget_mb * 1024 * 1024), timing);
+        timer.mark(timing.compute);
+        timing.compute -= timing.read + timing.write;
+    }
+    else
+    {
+        in.load();
+        timer.mark(timing.read);
+        counters.start();
+        pipeline.run(in.view(), out.view());
+        timer.mark(timing.compute);
+    }
+    counters.stop(timing);
+    out.close();
+    timer.mark(timing.write);
+
+    timing.pixels = (long long)in.width() * in.height();
+    timing.bytes = (double)timing.pixels * (in.channels() + out_channels);
+    return timer.finish();
+}
+
+// ===================== 批处理 =====================
+// 一次调用处理一批文件：读线程预读第N+1个文件、写线程写出第N-1个文件的同时，
+// 主线程用OpenMP计算第N个文件，I/O与计算互相重叠，也只需进出一次Python。
+// 线程之间用有界队列传递，队列容量限制了同时驻留在内存中的图像数量。
+
+// 有界阻塞队列：队列满时push()等待，close()之后pop()在取空时返回false
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(capacity) {}
+
+    void push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [&] { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+    }
+
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [&] { return !items_.empty() || closed_; });
+        if (items_.empty())
+            return false;
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    bool closed_ = false;
+    std::deque<T> items_;
+    std::mutex mutex_;
+    std::condition_variable not_full_, not_empty_;
+};
+
+// 批处理中一个文件的状态与各阶段耗时。某个文件出错只记录在error中，不影响其余文件
+struct BatchItem
+{
+    std::string input, output;
+    std::vector<unsigned char> in_file, out_file; // 完整的输入/输出文件内容，写出后即释放
+    size_t in_bytes = 0, out_bytes = 0;
+    double read_time = 0, compute_time = 0, write_time = 0;
+    std::string error;
+};
+
+// 把整个文件读入buf
+void read_whole_file(const std::string &path, std::vector<unsigned char> &buf)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("无法打开输入文件: " + path);
+    }
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok)
+    {
+        buf.resize(st.st_size);
+        ok = pread_full(fd, buf.data(), buf.size(), 0);
+    }
+    ::close(fd);
+    if (!ok)
+    {
+        throw std::runtime_error("读取输入文件失败: " + path);
+    }
+}
+
+void write_whole_file(const std::string &path, const std::vector<unsigned char> &buf)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        throw std::runtime_error("无法创建输出文件: " + path);
+    }
+    bool ok = pwrite_full(fd, buf.data(), buf.size(), 0);
+    ::close(fd);
+    if (!ok)
+    {
+        throw std::runtime_error("写入输出文件失败: " + path);
+    }
+}
+
+// 对内存中的BMP文件执行流水线，生成完整的输出BMP文件
+void run_pipeline_in_memory(const Pipeline &pipeline, BatchItem &item)
+{
+    std::vector<unsigned char> &file = item.in_file;
+    fileHeader fh;
+    fileInfo fi;
+    if (file.size() < sizeof(fileHeader) + sizeof(fileInfo))
+    {
+        throw std::runtime_error("不是有效的BMP文件: " + item.input);
+    }
+    memcpy(&fh, file.data(), sizeof(fileHeader));
+    memcpy(&fi, file.data() + sizeof(fileHeader), sizeof(fileInfo));
+    const char *error = check_bmp_header(fh, fi, file.size());
+    if (error)
+    {
+        throw std::runtime_error(error + item.input);
+    }
+    ImageView src = bmp_pixels_view(file.data(), fh, fi);
+
+    fileHeader ofh;
+    fileInfo ofi;
+    make_bmp_header(src.width, src.height, pipeline.output_channels(src.channels), &fi, ofh, ofi);
+    item.out_file.assign(ofh.bfSize, 0);
+    write_bmp_head(ofh, ofi, item.out_file.data());
+    pipeline.run(src, bmp_pixels_view(item.out_file.data(), ofh, ofi));
+}
+
+// 读、算、写三级流水：队列里传递的是items的下标，每个文件同一时刻只属于一个阶段
+void process_batch(const Pipeline &pipeline, std::vector<BatchItem> &items)
+{
+    const size_t depth = 2;
+    BoundedQueue<size_t> to_compute(depth), to_write(depth);
+
+    std::thread reader([&] {
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            BatchItem &item = items[i];
+            double start = omp_get_wtime();
+            try
+            {
+                read_whole_file(item.input, item.in_file);
+                item.in_bytes = item.in_file.size();
+            }
+            catch (const std::exception &e)
+            {
+                item.error = e.what();
+            }
+            item.read_time = omp_get_wtime() - start;
+            to_compute.push(i);
+        }
+        to_compute.close();
+    });
+
+    std::thread writer([&] {
+        size_t i;
+        while (to_write.pop(i))
+        {
+            BatchItem &item = items[i];
+            if (item.error.empty())
+            {
+                double start = omp_get_wtime();
+                try
+                {
+                    write_whole_file(item.output, item.out_file);
+                    item.out_bytes = item.out_file.size();
+                }
+                catch (const std::exception &e)
+                {
+                    item.error = e.what();
+                }
+                item.write_time = omp_get_wtime() - start;
+            }
+            std::vector<unsigned char>().swap(item.out_file);
+        }
+    });
+
+    size_t i;
+    while (to_compute.pop(i))
+    {
+        BatchItem &item = items[i];
+        if (item.error.empty())
+        {
+            double start = omp_get_wtime();
+            try
+            {
+                run_pipeline_in_memory(pipeline, item);
+            }
+            catch (const std::exception &e)
+            {
+                item.error = e.what();
+            }
+            item.compute_time = omp_get_wtime() - start;
+        }
+        std::vector<unsigned char>().swap(item.in_file);
+        to_write.push(i);
+    }
+    to_write.close();
+
+    reader.join();
+    writer.join();
+}
+
+// 批处理：op与params同run_pipeline中的一个算子，例如process_batch("gaussian", [5, 1.2], [(in, out), ...])。
+// 返回每个文件的各阶段耗时与吞吐量，以及整批的汇总
+py::dict process_batch_py(const std::string &op, const std::vector<py::object> &params,
+                          const std::vector<std::pair<std::string, std::string>> &files)
+{
+    std::vector<py::object> spec;
+    spec.push_back(py::str(op));
+    spec.insert(spec.end(), params.begin(), params.end());
+    Pipeline pipeline = parse_pipeline({spec});
+
+    std::vector<BatchItem> items(files.size());
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        items[i].input = files[i].first;
+        items[i].output = files[i].second;
+    }
+
+    double start_time = omp_get_wtime();
+    {
+        py::gil_scoped_release release;
+        process_batch(pipeline, items);
+    }
+    double elapsed = omp_get_wtime() - start_time;
+
+    const double MB = 1024.0 * 1024.0;
+    py::list per_file;
+    double read_time = 0, compute_time = 0, write_time = 0;
+    size_t bytes = 0, failed = 0;
+    for (const BatchItem &item : items)
+    {
+        double busy = item.read_time + item.compute_time + item.write_time;
+        py::dict d;
+        d["input"] = item.input;
+        d["output"] = item.output;
+        d["read_time"] = item.read_time;
+        d["compute_time"] = item.compute_time;
+        d["write_time"] = item.write_time;
+        d["bytes"] = item.in_bytes;
+        d["mb_per_second"] = busy > 0 ? item.in_bytes / MB / busy : 0.0;
+        if (item.error.empty())
+            d["error"] = py::none();
+        else
+            d["error"] = item.error;
+        per_file.append(d);
+
+        read_time += item.read_time;
+        compute_time += item.compute_time;
+        write_time += item.write_time;
+        bytes += item.in_bytes;
+        failed += item.error.empty() ? 0 : 1;
+    }
+
+    // 三个阶段耗时之和大于total_time的部分，就是I/O与计算重叠节省下来的时间
+    py::dict result;
+    result["files"] = per_file;
+    result["total_time"] = elapsed;
+    result["read_time"] = read_time;
+    result["compute_time"] = compute_time;
+    result["write_time"] = write_time;
+    result["failed"] = failed;
+    result["files_per_second"] = elapsed > 0 ? items.size() / elapsed : 0.0;
+    result["mb_per_second"] = elapsed > 0 ? bytes / MB / elapsed : 0.0;
+    return result;
+}
+
+// 拼接优化相关结构体。角点随每次拼接显式传递，不使用全局状态，多个拼接请求可以并发执行
+typedef struct
+{
+    cv::Point2f left_top;
+    cv::Point2f left_bottom;
+    cv::Point2f right_top;
+    cv::Point2f right_bottom;
+} four_corners_t;
+
+// 重叠区域：变换后第一张图四个角的包围盒与第二张图所在矩形的交集，corners为画布坐标。没有重叠时返回false。
+// img1_left表示第一张图是否在第二张图左边，决定过渡方向
+bool overlap_box(const four_corners_t &corners, const cv::Mat &img2, cv::Point offset, const cv::Mat &dst,
+                 cv::Rect &box, bool &img1_left)
+{
+    float min_x = std::min({corners.left_top.x, corners.left_bottom.x, corners.right_top.x, corners.right_bottom.x});
+    float max_x = std::max({corners.left_top.x, corners.left_bottom.x, corners.right_top.x, corners.right_bottom.x});
+    float min_y = std::min({corners.left_top.y, corners.left_bottom.y, corners.right_top.y, corners.right_bottom.y});
+    float max_y = std::max({corners.left_top.y, corners.left_bottom.y, corners.right_top.y, corners.right_bottom.y});
+
+    // 插值会让变换后的边缘向外多出约一个像素，包围盒各向外扩一个像素
+    int x0 = std::max({(int)std::floor(min_x) - 1, offset.x, 0});
+    int x1 = std::min({(int)std::ceil(max_x) + 1, offset.x + img2.cols, dst.cols});
+    int y0 = std::max({(int)std::floor(min_y) - 1, offset.y, 0});
+    int y1 = std::min({(int)std::ceil(max_y) + 1, offset.y + img2.rows, dst.rows});
+    if (x0 >= x1 || y0 >= y1)
+    {
+        return false;
+    }
+    box = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+    float center1 = (min_x + max_x) * 0.5f, center2 = offset.x + img2.cols * 0.5f;
+    img1_left = center1 <= center2;
+    return true;
+}
+
+// 只在重叠区域box内逐像素混合，其余部分由调用者按行整块复制，dst在进入前已经是“第一张图，其上覆盖第二张图”的结果。
+// 两张图都有像素时从第一张图一侧到第二张图一侧线性过渡（羽化），只有第二张图有像素时保持不变。
+// trans为第一张图变换到box内的像素（与box同样大小），img2位于画布的offset处
+template <typename Policy = OmpRuntimePolicy>
+void OptimizeSeam(const cv::Rect &box, bool img1_left, const cv::Mat &trans, const cv::Mat &img2, cv::Point offset,
+                  cv::Mat &dst)
+{
+    int x0 = box.x, x1 = box.x + box.width, y0 = box.y;
+
+    // 第一张图在左边时，权重从左到右由第一张图过渡到第二张图，否则反过来
+    float processWidth = (float)(x1 - x0);
+
+    parallel_for<Policy>(box.height, [&](int i) {
+        int y = y0 + i;
+        const uchar *t = trans.ptr<uchar>(i);
+        const uchar *s = img2.ptr<uchar>(y - offset.y);
+        uchar *d = dst.ptr<uchar>(y);
+        for (int x = x0; x < x1; x++)
+        {
+            const uchar *p1 = t + (x - x0) * 3;
+            if (p1[0] == 0 && p1[1] == 0 && p1[2] == 0)
+                continue;
+            const uchar *p2 = s + (x - offset.x) * 3;
+            float pos = (x - x0) / processWidth;
+            float weight = img1_left ? pos : 1.0f - pos; // 第二张图的权重
+            d[x * 3] = (uchar)(p1[0] * (1 - weight) + p2[0] * weight);
+            d[x * 3 + 1] = (uchar)(p1[1] * (1 - weight) + p2[1] * weight);
+            d[x * 3 + 2] = (uchar)(p1[2] * (1 - weight) + p2[2] * weight);
+        }
+    });
+}
+
+// 点(x, y)经单应矩阵H（CV_64F）变换后的位置
+cv::Point2f apply_homography(const cv::Mat &H, double x, double y)
+{
+    const double *h = H.ptr<double>(0);
+    double w = h[6] * x + h[7] * y + h[8];
+    return cv::Point2f((float)((h[0] * x + h[1] * y + h[2]) / w), (float)((h[3] * x + h[4] * y + h[5]) / w));
+}
+
+// ===================== 多频段融合 =====================
+// 重叠区域内按缝两侧的硬掩膜分频段融合：低频在宽范围内平滑过渡，高频只在缝附近很窄的范围内过渡，
+// 既没有羽化造成的重影，也看不出接缝。高斯/拉普拉斯金字塔的每一层都按行分块并行计算
+
+enum BlendMode
+{
+    BLEND_FEATHER,
+    BLEND_MULTIBAND
+};
+
+BlendMode parse_blend_mode(const std::string &blend)
+{
+    if (blend == "feather")
+        return BLEND_FEATHER;
+    if (blend == "multiband")
+        return BLEND_MULTIBAND;
+    throw std::runtime_error("未知的融合方式: " + blend);
+}
+
+// 金字塔中的浮点图像，各通道交错存放
+struct FloatImage
+{
+    int width = 0, height = 0, channels = 0;
+    std::vector<float> data;
+
+    void create(int w, int h, int cn)
+    {
+        width = w;
+        height = h;
+        channels = cn;
+        data.assign((size_t)w * h * cn, 0.0f);
+    }
+    float *row(int y) { return data.data() + (size_t)y * width * channels; }
+    const float *row(int y) const { return data.data() + (size_t)y * width * channels; }
+};
+
+static inline int reflect101(int i, int n)
+{
+    if (n == 1)
+        return 0;
+    while (i < 0 || i >= n)
+        i = i < 0 ? -i : 2 * n - 2 - i;
+    return i;
+}
+
+// 金字塔每一层按这么多行一块在线程之间分配
+static const int PYRAMID_TILE_ROWS = 16;
+
+// 5×5高斯核[1 4 6 4 1]/16平滑后隔行隔列取样，尺寸减半（向上取整），边界按BORDER_REFLECT_101
+template <typename Policy = OmpRuntimePolicy>
+void pyramid_down(const FloatImage &src, FloatImage &dst)
+{
+    int cn = src.channels, w = src.width;
+    dst.create((src.width + 1) / 2, (src.height + 1) / 2, cn);
+    int tiles = (dst.height + PYRAMID_TILE_ROWS - 1) / PYRAMID_TILE_ROWS;
+    auto init = [&] { return std::vector<float>((size_t)(w + 4) * cn); };
+    Policy::for_each(tiles, init, [&](std::vector<float> &tmp, int t) {
+        int yEnd = std::min((t + 1) * PYRAMID_TILE_ROWS, dst.height);
+        for (int y = t * PYRAMID_TILE_ROWS; y < yEnd; y++)
+        {
+            // 先竖直方向加权五行，结果两端各按反射补两个像素
+            const float *r0 = src.row(reflect101(2 * y - 2, src.height));
+            const float *r1 = src.row(reflect101(2 * y - 1, src.height));
+            const float *r2 = src.row(reflect101(2 * y, src.height));
+            const float *r3 = src.row(reflect101(2 * y + 1, src.height));
+            const float *r4 = src.row(reflect101(2 * y + 2, src.height));
+            float *v = tmp.data() + 2 * cn;
+            for (int i = 0; i < w * cn; i++)
+                v[i] = (r0[i] + r4[i] + 4 * (r1[i] + r3[i]) + 6 * r2[i]) * (1.0f / 16);
+            for (int c = 0; c < cn; c++)
+            {
+                v[-2 * cn + c] = v[reflect101(-2, w) * cn + c];
+                v[-cn + c] = v[reflect101(-1, w) * cn + c];
+                v[w * cn + c] = v[reflect101(w, w) * cn + c];
+                v[(w + 1) * cn + c] = v[reflect101(w + 1, w) * cn + c];
+            }
+            float *d = dst.row(y);
+            for (int x = 0; x < dst.width; x++)
+            {
+                const float *p = v + 2 * x * cn;
+                for (int c = 0; c < cn; c++)
+                    d[x * cn + c] = (p[c - 2 * cn] + p[c + 2 * cn] + 4 * (p[c - cn] + p[c + cn]) + 6 * p[c]) *
+                                    (1.0f / 16);
+            }
+        }
+    });
+}
+
+// pyramid_down的逆过程：插零后用4倍的同一高斯核平滑，放大到width×height。
+// 偶数位置为(1,6,1)/8，奇数位置为相邻两点的平均，边界复制最外侧的像素
+template <typename Policy = OmpRuntimePolicy>
+void pyramid_up(const FloatImage &src, int width, int height, FloatImage &dst)
+{
+    int cn = src.channels, sw = src.width, sh = src.height;
+    dst.create(width, height, cn);
+    int tiles = (height + PYRAMID_TILE_ROWS - 1) / PYRAMID_TILE_ROWS;
+    auto init = [&] { return std::vector<float>((size_t)sw * cn); };
+    Policy::for_each(tiles, init, [&](std::vector<float> &tmp, int t) {
+        int yEnd = std::min((t + 1) * PYRAMID_TILE_ROWS, height);
+        for (int y = t * PYRAMID_TILE_ROWS; y < yEnd; y++)
+        {
+            int m = y / 2;
+            const float *a = src.row(std::max(m - 1, 0));
+            const float *b = src.row(std::min(m, sh - 1));
+            const float *c = src.row(std::min(m + 1, sh - 1));
+            if (y % 2 == 0)
+                for (int i = 0; i < sw * cn; i++)
+                    tmp[i] = (a[i] + 6 * b[i] + c[i]) * (1.0f / 8);
+            else
+                for (int i = 0; i < sw * cn; i++)
+                    tmp[i] = (b[i] + c[i]) * 0.5f;
+
+            float *d = dst.row(y);
+            for (int x = 0; x < width; x++)
+            {
+                int n = x / 2;
+                const float *l = tmp.data() + std::max(n - 1, 0) * cn;
+                const float *h = tmp.data() + std::min(n, sw - 1) * cn;
+                const float *r = tmp.data() + std::min(n + 1, sw - 1) * cn;
+                for (int k = 0; k < cn; k++)
+                    d[x * cn + k] = x % 2 == 0 ? (l[k] + 6 * h[k] + r[k]) * (1.0f / 8) : (h[k] + r[k]) * 0.5f;
+            }
+        }
+    });
+}
+
+// 重叠区域内的多频段融合，参数含义与OptimizeSeam相同。缝取重叠区域的竖直中线，
+// 第一张图没有像素的位置掩膜为0，并用第二张图的像素填充，避免黑边混入低频
+template <typename Policy = OmpRuntimePolicy>
+void MultiBandSeam(const cv::Rect &box, bool img1_left, const cv::Mat &trans, const cv::Mat &img2, cv::Point offset,
+                   cv::Mat &dst, int levels)
+{
+    int w = box.width, h = box.height;
+    // 最粗一层至少还有两三个像素宽
+    levels = std::max(0, std::min(levels, (int)std::log2((double)std::min(w, h)) - 1));
+
+    std::vector<FloatImage> ga(levels + 1), gb(levels + 1), gm(levels + 1);
+    ga[0].create(w, h, 3);
+    gb[0].create(w, h, 3);
+    gm[0].create(w, h, 1);
+    parallel_for<Policy>(h, [&](int y) {
+        const uchar *t = trans.ptr<uchar>(y);
+        const uchar *s = img2.ptr<uchar>(box.y + y - offset.y) + (box.x - offset.x) * 3;
+        float *a = ga[0].row(y), *b = gb[0].row(y), *m = gm[0].row(y);
+        for (int x = 0; x < w; x++)
+        {
+            bool has1 = t[x * 3] != 0 || t[x * 3 + 1] != 0 || t[x * 3 + 2] != 0;
+            const uchar *p1 = has1 ? t + x * 3 : s + x * 3;
+            for (int c = 0; c < 3; c++)
+            {
+                a[x * 3 + c] = p1[c];
+                b[x * 3 + c] = s[x * 3 + c];
+            }
+            bool side1 = img1_left ? 2 * x < w : 2 * x >= w;
+            m[x] = has1 && side1 ? 1.0f : 0.0f;
+        }
+    });
+    for (int l = 0; l < levels; l++)
+    {
+        pyramid_down<Policy>(ga[l], ga[l + 1]);
+        pyramid_down<Policy>(gb[l], gb[l + 1]);
+        pyramid_down<Policy>(gm[l], gm[l + 1]);
+    }
+
+    // 从最粗一层开始：融合的高斯层放大后加上本层融合的拉普拉斯层 m*(A-up(A')) + (1-m)*(B-up(B'))
+    FloatImage result;
+    result.create(ga[levels].width, ga[levels].height, 3);
+    for (int l = levels; l >= 0; l--)
+    {
+        FloatImage upA, upB, upR;
+        bool top = l == levels;
+        int lw = ga[l].width, lh = ga[l].height;
+        if (!top)
+        {
+            pyramid_up<Policy>(ga[l + 1], lw, lh, upA);
+            pyramid_up<Policy>(gb[l + 1], lw, lh, upB);
+            pyramid_up<Policy>(result, lw, lh, upR);
+            result.create(lw, lh, 3);
+        }
+        parallel_for<Policy>(lh, [&](int y) {
+            const float *a = ga[l].row(y), *b = gb[l].row(y), *m = gm[l].row(y);
+            const float *ua = top ? NULL : upA.row(y), *ub = top ? NULL : upB.row(y), *ur = top ? NULL : upR.row(y);
+            float *r = result.row(y);
+            for (int x = 0; x < lw; x++)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    int i = x * 3 + c;
+                    float la = top ? a[i] : a[i] - ua[i];
+                    float lb = top ? b[i] : b[i] - ub[i];
+                    r[i] = (top ? 0.0f : ur[i]) + m[x] * la + (1 - m[x]) * lb;
+                }
+            }
+        });
+    }
+
+    parallel_for<Policy>(h, [&](int y) {
+        const float *r = result.row(y);
+        uchar *d = dst.ptr<uchar>(box.y + y) + box.x * 3;
+        for (int i = 0; i < w * 3; i++)
+            d[i] = clamp((int)std::lround(r[i]));
+    });
+}
+
+// 3×3矩阵求逆（伴随矩阵除以行列式），h按行存放。矩阵奇异时返回false
+static bool invert_3x3(const double *h, double *inv)
+{
+    double c0 = h[4] * h[8] - h[5] * h[7], c1 = h[5] * h[6] - h[3] * h[8], c2 = h[3] * h[7] - h[4] * h[6];
+    double det = h[0] * c0 + h[1] * c1 + h[2] * c2;
+    if (std::fabs(det) < 1e-12)
+        return false;
+    double k = 1.0 / det;
+    inv[0] = c0 * k;
+    inv[1] = (h[2] * h[7] - h[1] * h[8]) * k;
+    inv[2] = (h[1] * h[5] - h[2] * h[4]) * k;
+    inv[3] = c1 * k;
+    inv[4] = (h[0] * h[8] - h[2] * h[6]) * k;
+    inv[5] = (h[2] * h[3] - h[0] * h[5]) * k;
+    inv[6] = c2 * k;
+    inv[7] = (h[1] * h[6] - h[0] * h[7]) * k;
+    inv[8] = (h[0] * h[4] - h[1] * h[3]) * k;
+    return true;
+}
+
+// 透视变换的分块大小：块内各行映射回原图的位置相近，读原图时的缓存命中率比整行扫描高
+static const int WARP_TILE_ROWS = 32;
+static const int WARP_TILE_COLS = 256;
+
+// 把src（CV_8UC3）按单应矩阵M（src坐标到dst坐标，CV_64F）变换，只写dst中region内的像素，
+// region之外不读也不写。反向映射：对每个目标像素求原图位置后双线性插值，落在原图之外的像素写为黑色。
+// feather非空时（CV_32F，与dst同样大小）同时写出羽化权重：原图位置到最近的原图边缘的距离加1，图外为0，
+// 与像素用同一个位置，不必再单独变换一张权重图。
+// 每行的原图坐标先由omp simd循环成批算出，再逐像素取样，按块在线程之间分配
+template <typename Policy = OmpRuntimePolicy>
+void warp_perspective_region(const cv::Mat &src, const cv::Mat &M, cv::Mat &dst, cv::Rect region,
+                             cv::Mat *feather = NULL)
+{
+    double h[9];
+    if (!invert_3x3(M.ptr<double>(0), h))
+    {
+        throw std::runtime_error("单应矩阵不可逆，无法进行透视变换");
+    }
+    region = region & cv::Rect(0, 0, dst.cols, dst.rows);
+    if (region.empty())
+        return;
+
+    int sw = src.cols, sh = src.rows;
+    int tilesX = (region.width + WARP_TILE_COLS - 1) / WARP_TILE_COLS;
+    int tilesY = (region.height + WARP_TILE_ROWS - 1) / WARP_TILE_ROWS;
+    // 每个线程的工作区：一行内各像素的原图坐标，前半为x，后半为y
+    auto init = [] { return std::vector<float>(2 * WARP_TILE_COLS); };
+    Policy::for_each(tilesX * tilesY, init, [&](std::vector<float> &coords, int t) {
+        int tx = t % tilesX, ty = t / tilesX;
+        float *sx = coords.data(), *sy = sx + WARP_TILE_COLS;
+        int x0 = region.x + tx * WARP_TILE_COLS;
+        int n = std::min(WARP_TILE_COLS, region.x + region.width - x0);
+        int yEnd = std::min(region.y + (ty + 1) * WARP_TILE_ROWS, region.y + region.height);
+        for (int y = region.y + ty * WARP_TILE_ROWS; y < yEnd; y++)
+        {
+            // 分子分母都是x的一次函数
+            double X = h[0] * x0 + h[1] * y + h[2];
+            double Y = h[3] * x0 + h[4] * y + h[5];
+            double Z = h[6] * x0 + h[7] * y + h[8];
+#pragma omp simd
+            for (int i = 0; i < n; i++)
+            {
+                double w = 1.0 / (Z + h[6] * i);
+                sx[i] = (float)((X + h[0] * i) * w);
+                sy[i] = (float)((Y + h[3] * i) * w);
+            }
+
+            uchar *d = dst.ptr<uchar>(y) + (size_t)x0 * 3;
+            float *wt = feather ? feather->ptr<float>(y) + x0 : NULL;
+            for (int i = 0; i < n; i++)
+            {
+                float fx = sx[i], fy = sy[i];
+                // 取反的写法同时排除NaN
+                if (!(fx >= 0 && fy >= 0 && fx <= sw - 1 && fy <= sh - 1))
+                {
+                    d[i * 3] = d[i * 3 + 1] = d[i * 3 + 2] = 0;
+                    if (wt)
+                        wt[i] = 0.0f;
+                    continue;
+                }
+                if (wt)
+                    wt[i] = std::min(std::min(fx, sw - 1 - fx), std::min(fy, sh - 1 - fy)) + 1.0f;
+                int ix = (int)fx, iy = (int)fy;
+                float ax = fx - ix, ay = fy - iy;
+                int ix1 = std::min(ix + 1, sw - 1), iy1 = std::min(iy + 1, sh - 1);
+                const uchar *r0 = src.ptr<uchar>(iy), *r1 = src.ptr<uchar>(iy1);
+                for (int c = 0; c < 3; c++)
+                {
+                    float top = r0[ix * 3 + c] + ax * (r0[ix1 * 3 + c] - r0[ix * 3 + c]);
+                    float bottom = r1[ix * 3 + c] + ax * (r1[ix1 * 3 + c] - r1[ix * 3 + c]);
+                    d[i * 3 + c] = (uchar)(top + ay * (bottom - top) + 0.5f);
+                }
+            }
+        }
+    });
+}
+
+// 计算src的四个角经单应矩阵H（CV_64F）变换后的位置
+four_corners_t CalcCorners(const cv::Mat &H, const cv::Mat &src)
+{
+    four_corners_t corners;
+    corners.left_top = apply_homography(H, 0, 0);
+    corners.left_bottom = apply_homography(H, 0, src.rows);
+    corners.right_top = apply_homography(H, src.cols, 0);
+    corners.right_bottom = apply_homography(H, src.cols, src.rows);
+    return corners;
+}
+
+// ===================== Hamming距离匹配 =====================
+// ORB描述子为256位（32字节）。k=2暴力匹配按查询块×训练块分块：训练块（512个描述子，16KB）
+// 留在L1/L2中，被同一查询块的每一行反复使用；查询块在线程之间分配。
+// 单个距离用popcount计算：标量（POPCNT指令）、AVX2（pshufb按半字节查表再vpsadbw求和），
+// 支持AVX-512 VPOPCNTDQ时直接用64位popcount。与点运算一样在加载时按CPUID选择。
+
+struct HammingOpsTable
+{
+    const char *isa;
+    // 一个查询描述子与连续存放的n个训练描述子的距离
+    void (*distances)(const uint8_t *query, const uint8_t *train, int n, uint16_t *dist);
+};
+
+static inline int hamming256(const uint8_t *a, const uint8_t *b)
+{
+    uint64_t x[4], y[4];
+    memcpy(x, a, 32);
+    memcpy(y, b, 32);
+    return __builtin_popcountll(x[0] ^ y[0]) + __builtin_popcountll(x[1] ^ y[1]) +
+           __builtin_popcountll(x[2] ^ y[2]) + __builtin_popcountll(x[3] ^ y[3]);
+}
+
+static void hamming_distances_scalar(const uint8_t *q, const uint8_t *t, int n, uint16_t *dist)
+{
+    for (int i = 0; i < n; i++)
+        dist[i] = (uint16_t)hamming256(q, t + (size_t)i * 32);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("popcnt"))) static void hamming_distances_popcnt(const uint8_t *q, const uint8_t *t, int n,
+                                                                       uint16_t *dist)
+{
+    for (int i = 0; i < n; i++)
+        dist[i] = (uint16_t)hamming256(q, t + (size_t)i * 32);
+}
+
+// 四个距离各自的4个64位部分和错开16位相加后只需一次水平求和（每个距离不超过256，不会进位）
+__attribute__((target("avx2,popcnt"))) static inline void store_four_distances(__m256i p0, __m256i p1, __m256i p2,
+                                                                               __m256i p3, uint16_t *dist)
+{
+    __m256i x = _mm256_add_epi64(_mm256_add_epi64(p0, _mm256_slli_epi64(p1, 16)),
+                                 _mm256_add_epi64(_mm256_slli_epi64(p2, 32), _mm256_slli_epi64(p3, 48)));
+    __m128i h = _mm_add_epi64(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+    uint64_t sum = (uint64_t)_mm_cvtsi128_si64(h) + (uint64_t)_mm_extract_epi64(h, 1);
+    dist[0] = (uint16_t)(sum & 0xffff);
+    dist[1] = (uint16_t)((sum >> 16) & 0xffff);
+    dist[2] = (uint16_t)((sum >> 32) & 0xffff);
+    dist[3] = (uint16_t)(sum >> 48);
+}
+
+// 每个64位通道内的置位数（pshufb半字节查表后vpsadbw）
+__attribute__((target("avx2"))) static inline __m256i popcount_epi64_avx2(__m256i v)
+{
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low));
+    __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2,popcnt"))) static void hamming_distances_avx2(const uint8_t *q, const uint8_t *t, int n,
+                                                                          uint16_t *dist)
+{
+    __m256i vq = _mm256_loadu_si256((const __m256i *)q);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m256i *p = (const __m256i *)(t + (size_t)i * 32);
+        store_four_distances(popcount_epi64_avx2(_mm256_xor_si256(vq, _mm256_loadu_si256(p))),
+                             popcount_epi64_avx2(_mm256_xor_si256(vq, _mm256_loadu_si256(p + 1))),
+                             popcount_epi64_avx2(_mm256_xor_si256(vq, _mm256_loadu_si256(p + 2))),
+                             popcount_epi64_avx2(_mm256_xor_si256(vq, _mm256_loadu_si256(p + 3))), dist + i);
+    }
+    for (; i < n; i++)
+        dist[i] = (uint16_t)hamming256(q, t + (size_t)i * 32);
+}
+
+__attribute__((target("avx512vpopcntdq,avx512vl,avx2,popcnt"))) static void hamming_distances_vpopcnt(
+    const uint8_t *q, const uint8_t *t, int n, uint16_t *dist)
+{
+    __m256i vq = _mm256_loadu_si256((const __m256i *)q);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m256i *p = (const __m256i *)(t + (size_t)i * 32);
+        store_four_distances(_mm256_popcnt_epi64(_mm256_xor_si256(vq, _mm256_loadu_si256(p))),
+                             _mm256_popcnt_epi64(_mm256_xor_si256(vq, _mm256_loadu_si256(p + 1))),
+                             _mm256_popcnt_epi64(_mm256_xor_si256(vq, _mm256_loadu_si256(p + 2))),
+                             _mm256_popcnt_epi64(_mm256_xor_si256(vq, _mm256_loadu_si256(p + 3))), dist + i);
+    }
+    for (; i < n; i++)
+        dist[i] = (uint16_t)hamming256(q, t + (size_t)i * 32);
+}
+#endif
+
+static HammingOpsTable select_hamming_ops()
+{
+    HammingOpsTable table = {"scalar", hamming_distances_scalar};
+#if defined(__x86_64__) || defined(__i386__)
+    int maxLevel = isa_level_limit();
+    __builtin_cpu_init();
+    if (maxLevel >= 3 && __builtin_cpu_supports("avx512vpopcntdq") && __builtin_cpu_supports("avx512vl"))
+        table = {"avx512vpopcntdq", hamming_distances_vpopcnt};
+    else if (maxLevel >= 2 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+        table = {"avx2", hamming_distances_avx2};
+    else if (maxLevel >= 1 && __builtin_cpu_supports("popcnt"))
+        table = {"popcnt", hamming_distances_popcnt};
+#endif
+    return table;
+}
+
+static const HammingOpsTable hamming_ops = select_hamming_ops();
+
+// k=2匹配结果：最近邻的下标，以及最近与次近的距离（不存在时为257，大于任何256位描述子间的距离）
+struct HammingKnn2
+{
+    int trainIdx;
+    int best;
+    int second;
+};
+
+// 每个查询描述子在训练集中的最近与次近邻，描述子须为CV_8U的32字节ORB描述子
+template <typename Policy = OmpRuntimePolicy>
+std::vector<HammingKnn2> hamming_knn2(const cv::Mat &query, const cv::Mat &train)
+{
+    if (query.type() != CV_8UC1 || train.type() != CV_8UC1 || query.cols != 32 || train.cols != 32)
+    {
+        throw std::runtime_error("仅支持256位（32字节）的二进制描述子");
+    }
+    const cv::Mat q = query.isContinuous() ? query : query.clone();
+    const cv::Mat t = train.isContinuous() ? train : train.clone();
+    int nq = q.rows, nt = t.rows;
+    std::vector<HammingKnn2> result(nq, HammingKnn2{-1, 257, 257});
+
+    const int queryBlock = 64, trainBlock = 512;
+    int blocks = (nq + queryBlock - 1) / queryBlock;
+    auto init = [] { return std::vector<uint16_t>(trainBlock); };
+    Policy::for_each(blocks, init, [&](std::vector<uint16_t> &dist, int b) {
+        int q0 = b * queryBlock, q1 = std::min(q0 + queryBlock, nq);
+        for (int t0 = 0; t0 < nt; t0 += trainBlock)
+        {
+            int tn = std::min(trainBlock, nt - t0);
+            const uint8_t *tb = t.ptr<uint8_t>(t0);
+            for (int i = q0; i < q1; i++)
+            {
+                hamming_ops.distances(q.ptr<uint8_t>(i), tb, tn, dist.data());
+                HammingKnn2 &r = result[i];
+                for (int j = 0; j < tn; j++)
+                {
+                    int d = dist[j];
+                    if (d < r.best)
+                    {
+                        r.second = r.best;
+                        r.best = d;
+                        r.trainIdx = t0 + j;
+                    }
+                    else if (d < r.second)
+                    {
+                        r.second = d;
+                    }
+                }
+            }
+        }
+    });
+    return result;
+}
+
+// 比值检验：保留最近距离小于ratio倍次近距离的匹配
+std::vector<cv::DMatch> ratio_test(const std::vector<HammingKnn2> &knn, float ratio)
+{
+    std::vector<cv::DMatch> good;
+    for (size_t i = 0; i < knn.size(); i++)
+    {
+        if (knn[i].trainIdx >= 0 && knn[i].best < ratio * knn[i].second)
+            good.push_back(cv::DMatch((int)i, knn[i].trainIdx, (float)knn[i].best));
+    }
+    return good;
+}
+
+// 一张图的特征。关键点坐标是检测所用图像上的坐标，scale为原图与检测图的尺寸比（原分辨率检测时为1），
+// gray为原分辨率灰度图，供精化单应矩阵时使用
+struct ImageFeatures
+{
+    std::vector<cv::KeyPoint> keypoints;
+    cv::Mat descriptors;
+    cv::Mat gray;
+    double scale = 1.0;
+};
+
+// 检测ORB特征点并计算描述子。feature_resolution大于0且图像长边超过它时，
+// 在长边缩小到feature_resolution的灰度图上检测，原分辨率像素只用于之后的精化与变换
+void detect_orb_features(const cv::Mat &image, int feature_resolution, ImageFeatures &features)
+{
+    cv::cvtColor(image, features.gray, cv::COLOR_BGR2GRAY);
+    cv::Mat detectOn = features.gray;
+    int longSide = std::max(image.cols, image.rows);
+    features.scale = 1.0;
+    if (feature_resolution > 0 && longSide > feature_resolution)
+    {
+        features.scale = (double)longSide / feature_resolution;
+        cv::Size small(std::max(1, (int)std::lround(image.cols / features.scale)),
+                       std::max(1, (int)std::lround(image.rows / features.scale)));
+        cv::resize(features.gray, detectOn, small, 0, 0, cv::INTER_AREA);
+    }
+    cv::Ptr<cv::ORB> detector = cv::ORB::create(1000); // 增加特征点数量
+    detector->detectAndCompute(detectOn, cv::noArray(), features.keypoints, features.descriptors);
+}
+
+// 匹配两组特征并估计把第一张图映射到第二张图的单应矩阵（CV_64F），无法估计时退化为平移
+template <typename Policy = OmpRuntimePolicy>
+cv::Mat estimate_homography(const std::vector<cv::KeyPoint> &keypoints1, const cv::Mat &descriptors1,
+                            const std::vector<cv::KeyPoint> &keypoints2, const cv::Mat &descriptors2)
+{
+    // 检查是否检测到足够的特征点
+    if (keypoints1.size() < 10 || keypoints2.size() < 10) {
+        throw std::runtime_error("检测到的特征点数量不足（图像1: " + std::to_string(keypoints1.size()) + 
+                                ", 图像2: " + std::to_string(keypoints2.size()) + "），无法进行匹配");
+    }
+
+    // 并行分块的SIMD暴力匹配（k=2），比值检验只是对每个查询的O(1)筛选
+    std::vector<HammingKnn2> matches = hamming_knn2<Policy>(descriptors1, descriptors2);
+    std::vector<cv::DMatch> goodMatches = ratio_test(matches, 0.6f); // 放宽匹配条件
+
+    // 检查是否有足够的良好匹配
+    if (goodMatches.size() < 4) {
+        // 如果还是不够，尝试更宽松的条件
+        goodMatches = ratio_test(matches, 0.8f);
+        
+        if (goodMatches.size() < 4) {
+            throw std::runtime_error("良好匹配的特征点数量不足（需要至少4个，当前只有" + std::to_string(goodMatches.size()) + "个）");
+        }
+    }
+
+    std::vector<cv::Point2f> pts1, pts2;
+    for (auto &m : goodMatches)
+    {
+        pts1.push_back(keypoints1[m.queryIdx].pt);
+        pts2.push_back(keypoints2[m.trainIdx].pt);
+    }
+
+    cv::Mat H = cv::findHomography(pts1, pts2, cv::RANSAC);
+    if (H.empty()) {
+        // 如果无法计算单应性矩阵，退化为两组匹配点重心之间的平移（见函数说明）。
+        // 这是在释放GIL后运行的库代码，不向调用方的标准输出打印警告
+        cv::Point2f center1(0, 0), center2(0, 0);
+        for (const auto& pt : pts1) center1 += pt;
+        for (const auto& pt : pts2) center2 += pt;
+        center1 *= 1.0f / pts1.size();
+        center2 *= 1.0f / pts2.size();
+        
+        cv::Point2f translation = center2 - center1;
+        
+        // 创建简单的平移矩阵
+        H = cv::Mat::eye(3, 3, CV_64F);
+        H.at<double>(0, 2) = translation.x;
+        H.at<double>(1, 2) = translation.y;
+    }
+    return H;
+}
+
+// 在原分辨率上精化由缩小图估计、已换算到原图坐标的单应矩阵H：取第一张图中响应最强的若干关键点，
+// 以其原图邻域为模板，在第二张图上H预测位置附近的小窗口内做归一化互相关匹配，得到亚像素精度的对应点后重新估计。
+// 只读取这些小窗口，不在原分辨率上检测特征；可靠的对应点不足时返回H本身
+template <typename Policy = OmpRuntimePolicy>
+cv::Mat refine_homography(const cv::Mat &H, const ImageFeatures &f1, const ImageFeatures &f2)
+{
+    const int maxPoints = 200, half = 10, minPoints = 8;
+    const double minScore = 0.8;
+    // 缩小图上一两个像素的误差在原图上放大scale倍，搜索半径随之增大
+    int radius = (int)std::ceil(2 * std::max(f1.scale, f2.scale)) + 2;
+
+    std::vector<int> order(f1.keypoints.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = (int)i;
+    int n = std::min(maxPoints, (int)order.size());
+    std::partial_sort(order.begin(), order.begin() + n, order.end(),
+                      [&](int a, int b) { return f1.keypoints[a].response > f1.keypoints[b].response; });
+
+    std::vector<cv::Point2f> src(n), dst(n);
+    std::vector<char> found(n, 0);
+    parallel_for<Policy>(n, [&](int k) {
+        const cv::KeyPoint &kp = f1.keypoints[order[k]];
+        int x1 = (int)std::lround(kp.pt.x * f1.scale), y1 = (int)std::lround(kp.pt.y * f1.scale);
+        cv::Point2f predicted = apply_homography(H, x1, y1);
+        int x2 = (int)std::lround(predicted.x), y2 = (int)std::lround(predicted.y);
+        int r = radius + half;
+        if (x1 - half < 0 || y1 - half < 0 || x1 + half >= f1.gray.cols || y1 + half >= f1.gray.rows ||
+            x2 - r < 0 || y2 - r < 0 || x2 + r >= f2.gray.cols || y2 + r >= f2.gray.rows)
+            return;
+
+        cv::Mat patch = f1.gray(cv::Rect(x1 - half, y1 - half, 2 * half + 1, 2 * half + 1));
+        cv::Mat window = f2.gray(cv::Rect(x2 - r, y2 - r, 2 * r + 1, 2 * r + 1));
+        cv::Mat score;
+        cv::matchTemplate(window, patch, score, cv::TM_CCOEFF_NORMED);
+        double best = 0;
+        cv::Point loc;
+        cv::minMaxLoc(score, nullptr, &best, nullptr, &loc);
+        if (!(best >= minScore)) // 同时排除平坦区域产生的NaN
+            return;
+
+        // 峰值两侧做抛物线拟合得到亚像素偏移
+        auto peak = [](float a, float b, float c) {
+            float d = a - 2 * b + c;
+            return d < 0 ? 0.5f * (a - c) / d : 0.0f;
+        };
+        float dx = 0, dy = 0;
+        if (loc.x > 0 && loc.x < score.cols - 1)
+            dx = peak(score.at<float>(loc.y, loc.x - 1), score.at<float>(loc.y, loc.x), score.at<float>(loc.y, loc.x + 1));
+        if (loc.y > 0 && loc.y < score.rows - 1)
+            dy = peak(score.at<float>(loc.y - 1, loc.x), score.at<float>(loc.y, loc.x), score.at<float>(loc.y + 1, loc.x));
+        src[k] = cv::Point2f((float)x1, (float)y1);
+        dst[k] = cv::Point2f(x2 - radius + loc.x + dx, y2 - radius + loc.y + dy);
+        found[k] = 1;
+    });
+
+    std::vector<cv::Point2f> pts1, pts2;
+    for (int k = 0; k < n; k++)
+    {
+        if (found[k])
+        {
+            pts1.push_back(src[k]);
+            pts2.push_back(dst[k]);
+        }
+    }
+    if ((int)pts1.size() < minPoints)
+        return H;
+    cv::Mat refined = cv::findHomography(pts1, pts2, cv::RANSAC, 1.5);
+    return refined.empty() ? H : refined;
+}
+
+// 估计把第一张图映射到第二张图的单应矩阵（原图坐标）。特征在缩小图上检测时，
+// 先在缩小图坐标下估计，换算回原图坐标后再在原分辨率上精化
+template <typename Policy = OmpRuntimePolicy>
+cv::Mat estimate_homography(const ImageFeatures &f1, const ImageFeatures &f2)
+{
+    cv::Mat H = estimate_homography<Policy>(f1.keypoints, f1.descriptors, f2.keypoints, f2.descriptors);
+    if (f1.scale == 1.0 && f2.scale == 1.0)
+        return H;
+
+    cv::Mat up = cv::Mat::eye(3, 3, CV_64F), down = cv::Mat::eye(3, 3, CV_64F);
+    up.at<double>(0, 0) = up.at<double>(1, 1) = f2.scale;
+    down.at<double>(0, 0) = down.at<double>(1, 1) = 1.0 / f1.scale;
+    return refine_homography<Policy>(up * H * down, f1, f2);
+}
+
+void check_feature_resolution(int feature_resolution)
+{
+    if (feature_resolution < 0)
+    {
+        throw std::runtime_error("feature_resolution不能为负数");
+    }
+}
+
+// feature_resolution大于0时为由粗到细模式：特征检测与匹配在长边为feature_resolution的缩小图上进行，
+// 再用少量原分辨率对应点精化，只有最终的变换与融合处理全部原分辨率像素
+// blend为"feather"时在重叠区域线性过渡，为"multiband"时按拉普拉斯金字塔分频段融合
+template <typename Policy = OmpRuntimePolicy>
+Timing stitch_images_surf_py(const std::string &input1, const std::string &input2, const std::string &output,
+                             int feature_resolution, const std::string &blend)
+{
+    check_feature_resolution(feature_resolution);
+    BlendMode blend_mode = parse_blend_mode(blend);
+    Timing timing;
+    PhaseTimer timer(timing);
+
+    cv::Mat image01 = cv::imread(input1);
+    cv::Mat image02 = cv::imread(input2);
+    if (image01.empty() || image02.empty())
+    {
+        throw std::runtime_error("无法读取输入图像");
+    }
+    timer.mark(timing.read);
+    ComputeCounters counters;
+    counters.start();
+
+    ImageFeatures features1, features2;
+    detect_orb_features(image01, feature_resolution, features1);
+    detect_orb_features(image02, feature_resolution, features2);
+    cv::Mat H = estimate_homography<Policy>(features1, features2);
+
+    four_corners_t corners = CalcCorners(H, image01);
+    
+    // 计算变换后图像的边界
+    float min_x = std::min({corners.left_top.x, corners.left_bottom.x, 0.0f});
+    float max_x = std::max({corners.right_top.x, corners.right_bottom.x, (float)image02.cols});
+    float min_y = std::min({corners.left_top.y, corners.right_top.y, 0.0f});
+    float max_y = std::max({corners.left_bottom.y, corners.right_bottom.y, (float)image02.rows});
+    
+    // 确保边界为正数
+    int dst_width = std::max(1, (int)(max_x - min_x));
+    int dst_height = std::max(1, (int)(max_y - min_y));
+    
+    // 创建变换矩阵，包含平移
+    cv::Mat H_translated = cv::Mat::eye(3, 3, CV_64F);
+    H_translated.at<double>(0, 2) = -min_x;
+    H_translated.at<double>(1, 2) = -min_y;
+    cv::Mat H_final = H_translated * H;
+    
+    // 计算第二张图像在dst中的位置
+    int x_offset = (int)(-min_x);
+    int y_offset = (int)(-min_y);
+    
+    // 确保偏移量在合理范围内
+    x_offset = std::max(0, std::min(x_offset, dst_width - 1));
+    y_offset = std::max(0, std::min(y_offset, dst_height - 1));
+    
+    // 计算第二张图像的有效区域
+    int img2_width = std::max(0, std::min(image02.cols, dst_width - x_offset));
+    int img2_height = std::max(0, std::min(image02.rows, dst_height - y_offset));
+
+    // 更新角点坐标以匹配新的坐标系
+    corners.left_top.x -= min_x;
+    corners.left_top.y -= min_y;
+    corners.left_bottom.x -= min_x;
+    corners.left_bottom.y -= min_y;
+    corners.right_top.x -= min_x;
+    corners.right_top.y -= min_y;
+    corners.right_bottom.x -= min_x;
+    corners.right_bottom.y -= min_y;
+
+    // 第一张图直接变换到画布上它的包围盒内，不再生成整幅画布大小的中间图
+    cv::Mat dst(dst_height, dst_width, CV_8UC3);
+    float bx0 = std::min({corners.left_top.x, corners.left_bottom.x, corners.right_top.x, corners.right_bottom.x});
+    float bx1 = std::max({corners.left_top.x, corners.left_bottom.x, corners.right_top.x, corners.right_bottom.x});
+    float by0 = std::min({corners.left_top.y, corners.left_bottom.y, corners.right_top.y, corners.right_bottom.y});
+    float by1 = std::max({corners.left_top.y, corners.left_bottom.y, corners.right_top.y, corners.right_bottom.y});
+    int wx0 = std::max(0, (int)std::floor(bx0) - 1), wy0 = std::max(0, (int)std::floor(by0) - 1);
+    cv::Rect warpBox = cv::Rect(wx0, wy0, (int)std::ceil(bx1) + 2 - wx0, (int)std::ceil(by1) + 2 - wy0) &
+                       cv::Rect(0, 0, dst_width, dst_height);
+    warp_perspective_region<Policy>(image01, H_final, dst, warpBox);
+
+    // 重叠区域会被第二张图覆盖，融合所需的第一张图像素单独变换一份，只有重叠区域大小
+    cv::Rect overlap;
+    bool img1_left = true;
+    bool overlaps = overlap_box(corners, image02, cv::Point(x_offset, y_offset), dst, overlap, img1_left);
+    cv::Mat overlap1;
+    if (overlaps)
+    {
+        cv::Mat shift = cv::Mat::eye(3, 3, CV_64F);
+        shift.at<double>(0, 2) = -overlap.x;
+        shift.at<double>(1, 2) = -overlap.y;
+        overlap1.create(overlap.height, overlap.width, CV_8UC3);
+        warp_perspective_region<Policy>(image01, shift * H_final, overlap1, cv::Rect(0, 0, overlap.width, overlap.height));
+    }
+
+    // 包围盒以外置为黑色，再在其上整行覆盖第二张图
+    parallel_for<Policy>(dst_height, [&](int y) {
+        uchar *d = dst.ptr<uchar>(y);
+        if (y < warpBox.y || y >= warpBox.y + warpBox.height)
+        {
+            memset(d, 0, (size_t)dst_width * 3);
+        }
+        else
+        {
+            memset(d, 0, (size_t)warpBox.x * 3);
+            int right = warpBox.x + warpBox.width;
+            memset(d + (size_t)right * 3, 0, (size_t)(dst_width - right) * 3);
+        }
+        if (y >= y_offset && y < y_offset + img2_height)
+        {
+            memcpy(d + (size_t)x_offset * 3, image02.ptr<uchar>(y - y_offset), (size_t)img2_width * 3);
+        }
+    });
+
+    // 只在重叠区域内逐像素混合
+    if (overlaps)
+    {
+        if (blend_mode == BLEND_MULTIBAND)
+            MultiBandSeam<Policy>(overlap, img1_left, overlap1, image02, cv::Point(x_offset, y_offset), dst, 5);
+        else
+            OptimizeSeam<Policy>(overlap, img1_left, overlap1, image02, cv::Point(x_offset, y_offset), dst);
+    }
+    timer.mark(timing.compute);
+    counters.stop(timing);
+
+    cv::imwrite(output, dst);
+    timer.mark(timing.write);
+
+    timing.pixels = (long long)dst_width * dst_height;
+    timing.bytes = (double)(image01.total() + image02.total() + dst.total()) * 3;
+    return timer.finish();
+}
+// 全景图中的一张图：在画布上的包围盒、变换到包围盒内的像素，以及羽化权重（离原图边缘越远越大，图外为0）
+struct WarpedImage
+{
+    cv::Rect box;
+    cv::Mat pixels; // CV_8UC3
+    cv::Mat weight; // CV_32F
+};
+
+// 画布面积超过全部输入像素数的这么多倍时，认为单应矩阵链已经病态（例如某对图匹配错误、透视被极度放大）
+static const double STITCH_MAX_CANVAS_RATIO = 16.0;
+
+// 多张图拼接：所有图并行检测特征，相邻图两两并行匹配，单应矩阵沿链累乘到中间那张图的坐标系，
+// 每张图只变换一次，且只变换到它自己在画布上的包围盒内。合成时按行并行，
+// 每个像素取覆盖它的各图按羽化权重的加权平均，与合成顺序无关。feature_resolution含义同stitch_images_surf_py
+template <typename Policy = OmpRuntimePolicy>
+Timing stitch_many_py(const std::vector<std::string> &inputs, const std::string &output, int feature_resolution)
+{
+    check_feature_resolution(feature_resolution);
+    int n = (int)inputs.size();
+    if (n < 2)
+    {
+        throw std::runtime_error("至少需要两张图像进行拼接");
+    }
+    Timing timing;
+    PhaseTimer timer(timing);
+
+    // 并行读取，再并行检测特征。并行区域内不能抛出异常，先记下第一个错误
+    std::vector<cv::Mat> images(n);
+    std::string error;
+    parallel_for<Policy>(n, [&](int i) {
+        images[i] = cv::imread(inputs[i]);
+        if (images[i].empty())
+        {
+#pragma omp critical(stitch_error)
+            if (error.empty())
+                error = "无法读取输入图像: " + inputs[i];
+        }
+    });
+    if (!error.empty())
+    {
+        throw std::runtime_error(error);
+    }
+    timer.mark(timing.read);
+    double in_bytes = 0;
+    for (const cv::Mat &img : images)
+        in_bytes += (double)img.total() * 3;
+    ComputeCounters counters;
+    counters.start();
+
+    std::vector<ImageFeatures> features(n);
+    parallel_for<Policy>(n, [&](int i) {
+        try
+        {
+            detect_orb_features(images[i], feature_resolution, features[i]);
+        }
+        catch (const std::exception &e)
+        {
+#pragma omp critical(stitch_error)
+            if (error.empty())
+                error = inputs[i] + ": " + e.what();
+        }
+    });
+    if (!error.empty())
+    {
+        throw std::runtime_error(error);
+    }
+
+    // 相邻图两两并行匹配：pair[i]把第i张图映射到第i+1张图
+    std::vector<cv::Mat> pair(n - 1);
+    parallel_for<Policy>(n - 1, [&](int i) {
+        try
+        {
+            pair[i] = estimate_homography<Policy>(features[i], features[i + 1]);
+        }
+        catch (const std::exception &e)
+        {
+#pragma omp critical(stitch_error)
+            if (error.empty())
+                error = "第" + std::to_string(i + 1) + "与第" + std::to_string(i + 2) + "张图像匹配失败: " + e.what();
+        }
+    });
+    if (!error.empty())
+    {
+        throw std::runtime_error(error);
+    }
+
+    // 以中间的图为参考系累乘单应矩阵，误差沿链向两端累积，参考图放在中间使最长的链最短
+    int ref = n / 2;
+    std::vector<cv::Mat> toRef(n);
+    toRef[ref] = cv::Mat::eye(3, 3, CV_64F);
+    for (int i = ref - 1; i >= 0; i--)
+        toRef[i] = toRef[i + 1] * pair[i];
+    for (int i = ref + 1; i < n; i++)
+        toRef[i] = toRef[i - 1] * pair[i - 1].inv();
+    features.clear();
+
+    // 画布范围：所有图变换后四个角的包围盒
+    std::vector<four_corners_t> corners(n);
+    float min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+    for (int i = 0; i < n; i++)
+    {
+        corners[i] = CalcCorners(toRef[i], images[i]);
+        const four_corners_t &c = corners[i];
+        float xs[] = {c.left_top.x, c.left_bottom.x, c.right_top.x, c.right_bottom.x};
+        float ys[] = {c.left_top.y, c.left_bottom.y, c.right_top.y, c.right_bottom.y};
+        if (i == 0)
+        {
+            min_x = max_x = xs[0];
+            min_y = max_y = ys[0];
+        }
+        for (int k = 0; k < 4; k++)
+        {
+            if (!std::isfinite(xs[k]) || !std::isfinite(ys[k]))
+            {
+                throw std::runtime_error("第" + std::to_string(i + 1) + "张图像的单应矩阵退化，无法确定画布范围");
+            }
+            min_x = std::min(min_x, xs[k]);
+            max_x = std::max(max_x, xs[k]);
+            min_y = std::min(min_y, ys[k]);
+            max_y = std::max(max_y, ys[k]);
+        }
+    }
+    // 先在浮点上检查画布大小，再转换为int，避免溢出
+    if ((double)(max_x - min_x) * (max_y - min_y) > STITCH_MAX_CANVAS_RATIO * (in_bytes / 3))
+    {
+        throw std::runtime_error("拼接结果的画布过大，单应矩阵可能估计错误，请检查输入图像是否按相邻顺序排列");
+    }
+    int dst_width = std::max(1, (int)std::ceil(max_x - min_x));
+    int dst_height = std::max(1, (int)std::ceil(max_y - min_y));
+    cv::Rect canvas(0, 0, dst_width, dst_height);
+
+    // 每张图各自变换到画布上的包围盒内，与stitch_images_surf_py用同一个分块并行的透视变换，
+    // 羽化权重在变换时由同一个原图位置算出。图像逐张处理，每张图内部按块并行
+    std::vector<WarpedImage> warped(n);
+    for (int i = 0; i < n; i++)
+    {
+        const four_corners_t &c = corners[i];
+        float bx0 = std::min({c.left_top.x, c.left_bottom.x, c.right_top.x, c.right_bottom.x}) - min_x;
+        float bx1 = std::max({c.left_top.x, c.left_bottom.x, c.right_top.x, c.right_bottom.x}) - min_x;
+        float by0 = std::min({c.left_top.y, c.left_bottom.y, c.right_top.y, c.right_bottom.y}) - min_y;
+        float by1 = std::max({c.left_top.y, c.left_bottom.y, c.right_top.y, c.right_bottom.y}) - min_y;
+        int x0 = (int)std::floor(bx0), y0 = (int)std::floor(by0);
+        cv::Rect box = cv::Rect(x0, y0, (int)std::ceil(bx1) - x0 + 1, (int)std::ceil(by1) - y0 + 1) & canvas;
+        warped[i].box = box;
+        if (box.empty())
+            continue;
+
+        cv::Mat shift = cv::Mat::eye(3, 3, CV_64F);
+        shift.at<double>(0, 2) = -min_x - box.x;
+        shift.at<double>(1, 2) = -min_y - box.y;
+        warped[i].pixels.create(box.height, box.width, CV_8UC3);
+        warped[i].weight.create(box.height, box.width, CV_32F);
+        warp_perspective_region<Policy>(images[i], shift * toRef[i], warped[i].pixels,
+                                        cv::Rect(0, 0, box.width, box.height), &warped[i].weight);
+        images[i].release();
+    }
+
+    cv::Mat dst(dst_height, dst_width, CV_8UC3);
+    // 每个线程的工作区：一行的加权颜色和与权重和
+    struct RowSums
+    {
+        std::vector<float> acc, wsum;
+    };
+    auto init = [&] {
+        RowSums b;
+        b.acc.resize((size_t)dst_width * 3);
+        b.wsum.resize(dst_width);
+        return b;
+    };
+    Policy::for_each(dst_height, init, [&](RowSums &b, int y) {
+        std::vector<float> &acc = b.acc, &wsum = b.wsum;
+        std::fill(acc.begin(), acc.end(), 0.0f);
+        std::fill(wsum.begin(), wsum.end(), 0.0f);
+        for (const WarpedImage &w : warped)
+        {
+            if (y < w.box.y || y >= w.box.y + w.box.height)
+                continue;
+            const uchar *p = w.pixels.ptr<uchar>(y - w.box.y);
+            const float *wt = w.weight.ptr<float>(y - w.box.y);
+            for (int x = 0; x < w.box.width; x++)
+            {
+                float k = wt[x];
+                if (k <= 0)
+                    continue;
+                int dx = w.box.x + x;
+                acc[dx * 3] += k * p[x * 3];
+                acc[dx * 3 + 1] += k * p[x * 3 + 1];
+                acc[dx * 3 + 2] += k * p[x * 3 + 2];
+                wsum[dx] += k;
+            }
+        }
+        uchar *d = dst.ptr<uchar>(y);
+        for (int x = 0; x < dst_width; x++)
+        {
+            float inv = wsum[x] > 0 ? 1.0f / wsum[x] : 0.0f;
+            for (int c = 0; c < 3; c++)
+                d[x * 3 + c] = clamp((int)(acc[x * 3 + c] * inv + 0.5f));
+        }
+    });
+    timer.mark(timing.compute);
+    counters.stop(timing);
+
+    cv::imwrite(output, dst);
+    timer.mark(timing.write);
+
+    timing.pixels = (long long)dst_width * dst_height;
+    timing.bytes = in_bytes + (double)dst.total() * 3;
+    return timer.finish();
+}
+
+
+// ===================== NumPy缓冲区接口 =====================
+// 以下重载直接在调用方的NumPy数组上计算，不经过磁盘，也不复制输入数据。
+// 输入为HxWx3（BGR，与BMP/OpenCV一致）或HxW的uint8数组，行之间可以有任意跨度，
+// 计算期间释放GIL，多个Python线程可以同时调用。
+
+// 将NumPy数组包装为ImageView，要求每行内像素连续存放
+ImageView view_from_array(const py::array_t<uint8_t> &arr)
+{
+    if (arr.ndim() != 2 && !(arr.ndim() == 3 && arr.shape(2) == 3))
+    {
+        throw std::runtime_error("仅支持HxWx3或HxW的uint8数组");
+    }
+    int channels = (arr.ndim() == 3) ? 3 : 1;
+    if (arr.strides(1) != channels || (channels == 3 && arr.strides(2) != 1))
+    {
+        throw std::runtime_error("数组每行内的像素必须连续存放");
+    }
+    if (arr.shape(0) <= 0 || arr.shape(1) <= 0)
+    {
+        throw std::runtime_error("图像尺寸不能为空");
+    }
+    return ImageView{(unsigned char *)arr.data(), (int)arr.shape(1), (int)arr.shape(0),
+                     (ptrdiff_t)arr.strides(0), channels};
+}
+
+// 分配与视图尺寸相同的输出数组
+py::array_t<uint8_t> allocate_array(int width, int height, int channels)
+{
+    if (channels == 1)
+        return py::array_t<uint8_t>({(py::ssize_t)height, (py::ssize_t)width});
+    return py::array_t<uint8_t>({(py::ssize_t)height, (py::ssize_t)width, (py::ssize_t)channels});
+}
+
+py::array_t<uint8_t> convert_to_grayscale_array(const py::array_t<uint8_t> &image)
+{
+    ImageView src = view_from_array(image);
+    py::array_t<uint8_t> result = allocate_array(src.width, src.height, 1);
+    ImageView dst = view_from_array(result);
+    {
+        py::gil_scoped_release release;
+        grayscale_kernel(src, dst);
+    }
+    return result;
+}
+
+py::array_t<uint8_t> convert_to_binary_array(const py::array_t<uint8_t> &image, int threshold)
+{
+    ImageView src = view_from_array(image);
+    py::array_t<uint8_t> result = allocate_array(src.width, src.height, 1);
+    ImageView dst = view_from_array(result);
+    {
+        py::gil_scoped_release release;
+        binary_kernel(src, dst, threshold);
+    }
+    return result;
+}
+
+// 自动阈值二值化，二值图在返回字典的image中
+py::dict convert_to_binary_auto_array(const py::array_t<uint8_t> &image, const std::string &method, int classes)
+{
+    ThresholdMethod threshold_method = parse_threshold_method(method);
+    ImageView src = view_from_array(image);
+    py::array_t<uint8_t> binary = allocate_array(src.width, src.height, 1);
+    ImageView dst = view_from_array(binary);
+    AutoThresholdResult result;
+    {
+        py::gil_scoped_release release;
+        result = auto_binary_kernel(src, dst, threshold_method, classes);
+    }
+    py::dict d = auto_threshold_dict(result);
+    d["image"] = binary;
+    return d;
+}
+
+py::array_t<uint8_t> apply_point_ops_array(const py::array_t<uint8_t> &image,
+                                           const std::vector<std::vector<py::object>> &ops)
+{
+    PointLut lut = parse_point_ops(ops);
+    ImageView src = view_from_array(image);
+    py::array_t<uint8_t> result = allocate_array(src.width, src.height, src.channels);
+    ImageView dst = view_from_array(result);
+    {
+        py::gil_scoped_release release;
+        lut_kernel(src, dst, lut);
+    }
+    return result;
+}
+
+// 原地修改调用方的数组，不分配输出
+void apply_point_ops_inplace(py::array_t<uint8_t> image, const std::vector<std::vector<py::object>> &ops)
+{
+    PointLut lut = parse_point_ops(ops);
+    if (!image.writeable())
+    {
+        throw std::runtime_error("原地修改要求数组可写");
+    }
+    ImageView view = view_from_array(image);
+    py::gil_scoped_release release;
+    lut_kernel(view, view, lut);
+}
+
+// 返回ops复合后的3x256查找表（B、G、R各一行），可以作为("table", lut)再次传入
+py::array_t<uint8_t> build_point_lut(const std::vector<std::vector<py::object>> &ops)
+{
+    PointLut lut = parse_point_ops(ops);
+    py::array_t<uint8_t> result({(py::ssize_t)3, (py::ssize_t)256});
+    memcpy(result.mutable_data(), lut.table, 3 * 256);
+    return result;
+}
+
+py::array_t<uint8_t> adjust_brightness_array(const py::array_t<uint8_t> &image, int delta)
+{
+    ImageView src = view_from_array(image);
+    py::array_t<uint8_t> result = allocate_array(src.width, src.height, src.channels);
+    ImageView dst = view_from_array(result);
+    {
+        py::gil_scoped_release release;
+        brightness_kernel(src, dst, delta);
+    }
+    return result;
+}
+
+py::array_t<uint8_t> apply_gaussian_blur_array(const py::array_t<uint8_t> &image, int kernel_size, float sigma,
+                                               const std::string &method)
+{
+    GaussianMethod gaussian_method = parse_gaussian_method(method);
+    ImageView src = view_from_array(image);
+    py::array_t<uint8_t> result = allocate_array(src.width, src.height, src.channels);
+    ImageView dst = view_from_array(result);
+    {
+        py::gil_scoped_release release;
+        gaussian_blur_kernel(src, dst, kernel_size, sigma, gaussian_method);
+    }
+    return result;
+}
+
+py::array_t<uint8_t> apply_custom_convolution_array(const py::array_t<uint8_t> &image,
+                                                    const std::vector<std::vector<float>> &kernel_vec, float divisor,
+                                                    const std::string &method)
+{
+    ConvolutionMethod convolution_method = parse_convolution_method(method);
+    ImageView src = view_from_array(image);
+    py::array_t<uint8_t> result = allocate_array(src.width, src.height, src.channels);
+    ImageView dst = view_from_array(result);
+    {
+        py::gil_scoped_release release;
+        custom_convolution_kernel(src, dst, kernel_vec, divisor, convolution_method);
+    }
+    return result;
+}
+
+py::array_t<uint8_t> apply_sobel_edge_detection_array(const py::array_t<uint8_t> &image, bool single_channel)
+{
+    ImageView src = view_from_array(image);
+    py::array_t<uint8_t> result = allocate_array(src.width, src.height, single_channel ? 1 : src.channels);
+    ImageView dst = view_from_array(result);
+    {
+        py::gil_scoped_release release;
+        sobel_kernel(src, dst);
+    }
+    return result;
+}
+
+py::array_t<uint8_t> apply_canny_edge_detection_array(const py::array_t<uint8_t> &image, double low_threshold,
+                                                      double high_threshold, int kernel_size, float sigma,
+                                                      bool l2_gradient)
+{
+    ImageView src = view_from_array(image);
+    py::array_t<uint8_t> result = allocate_array(src.width, src.height, 1);
+    ImageView dst = view_from_array(result);
+    {
+        py::gil_scoped_release release;
+        canny_kernel(src, dst, low_threshold, high_threshold, kernel_size, sigma, l2_gradient);
+    }
+    return result;
+}
+
+py::array_t<uint8_t> run_pipeline_array(const py::array_t<uint8_t> &image,
+                                        const std::vector<std::vector<py::object>> &ops)
+{
+    Pipeline pipeline = parse_pipeline(ops);
+    ImageView src = view_from_array(image);
+    py::array_t<uint8_t> result = allocate_array(src.width, src.height, pipeline.output_channels(src.channels));
+    ImageView dst = view_from_array(result);
+    {
+        py::gil_scoped_release release;
+        pipeline.run(src, dst);
+    }
+    return result;
+}
+
+// ===================== 执行上下文 =====================
+// OpenMP的线程数、调度方式等ICV属于调用线程自己的数据环境（libgomp为每个调用线程各存一份，
+// 线程池也按调用线程区分），所以在调用线程上设置、调用结束时恢复，就只影响这一次调用：
+// 不同Python线程上的并发调用各用各的设置，互不覆盖。
+
+// 一次调用的执行参数
+struct ExecutionContext
+{
+    int threads = 0;       // 线程数，0表示使用进程默认值（set_omp_threads或OMP_NUM_THREADS）
+    std::string schedule;  // 行/图块循环的调度方式："static"、"dynamic"、"guided"或"auto"，空表示沿用OMP_SCHEDULE，
+                           // 两者都未设置时为static（与libgomp默认的dynamic,1不同，保持原先的静态划分）
+    int chunk = 0;         // 调度块大小，0表示由运行时决定
+    std::vector<int> cpus; // 非空时把第i个OpenMP线程绑定到cpus[i % cpus.size()]号CPU
+};
+
+// set_omp_threads设置的进程默认线程数，0表示未设置
+static std::atomic<int> default_omp_threads(0);
+
+// Python中with ExecutionContext(...)进入的上下文，每个线程各自一个栈
+static thread_local std::vector<ExecutionContext> context_stack;
+
+// 当前线程生效的上下文，threads大于0时覆盖其中的线程数
+ExecutionContext current_context(int threads)
+{
+    ExecutionContext ctx = context_stack.empty() ? ExecutionContext() : context_stack.back();
+    if (threads > 0)
+        ctx.threads = threads;
+    if (ctx.threads <= 0)
+        ctx.threads = default_omp_threads.load();
+    return ctx;
+}
+
+omp_sched_t parse_schedule(const std::string &schedule)
+{
+    if (schedule == "static")
+        return omp_sched_static;
+    if (schedule == "dynamic")
+        return omp_sched_dynamic;
+    if (schedule == "guided")
+        return omp_sched_guided;
+    if (schedule == "auto")
+        return omp_sched_auto;
+    throw std::runtime_error("未知的调度方式: " + schedule);
+}
+
+// 在当前线程上应用执行上下文，析构时恢复原来的设置
+class ScopedExecution
+{
+public:
+    explicit ScopedExecution(const ExecutionContext &ctx)
+    {
+        if (ctx.threads < 0 || ctx.chunk < 0)
+        {
+            throw std::runtime_error("线程数与调度块大小不能为负数");
+        }
+        for (int cpu : ctx.cpus)
+        {
+            if (cpu < 0 || cpu >= CPU_SETSIZE)
+            {
+                throw std::runtime_error("无效的CPU编号: " + std::to_string(cpu));
+            }
+        }
+        omp_sched_t kind = omp_sched_static;
+        if (!ctx.schedule.empty())
+            kind = parse_schedule(ctx.schedule);
+
+        saved_threads_ = omp_get_max_threads();
+        omp_get_schedule(&saved_kind_, &saved_chunk_);
+        if (ctx.threads > 0)
+            omp_set_num_threads(ctx.threads);
+        if (!ctx.schedule.empty())
+            omp_set_schedule(kind, ctx.chunk);
+        else if (!getenv("OMP_SCHEDULE"))
+            omp_set_schedule(omp_sched_static, 0);
+        if (!ctx.cpus.empty())
+            pin(ctx.cpus);
+    }
+
+    ~ScopedExecution()
+    {
+        if (!saved_masks_.empty())
+            unpin();
+        omp_set_schedule(saved_kind_, saved_chunk_);
+        omp_set_num_threads(saved_threads_);
+    }
+
+    ScopedExecution(const ScopedExecution &) = delete;
+    ScopedExecution &operator=(const ScopedExecution &) = delete;
+
+private:
+    // 线程池中的线程在本线程随后的并行区域里按编号复用，因此绑定一次即可作用于整个调用（尽力而为）
+    void pin(const std::vector<int> &cpus)
+    {
+        int n = omp_get_max_threads();
+        cpu_set_t current;
+        pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &current);
+        saved_masks_.assign(n, current);
+#pragma omp parallel num_threads(n)
+        {
+            int t = omp_get_thread_num();
+            pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &saved_masks_[t]);
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[t % cpus.size()], &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+        }
+    }
+
+    void unpin()
+    {
+        int n = (int)saved_masks_.size();
+#pragma omp parallel num_threads(n)
+        {
+            int t = omp_get_thread_num();
+            pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &saved_masks_[t]);
+        }
+    }
+
+    int saved_threads_;
+    omp_sched_t saved_kind_;
+    int saved_chunk_;
+    std::vector<cpu_set_t> saved_masks_;
+};
+
+// 给绑定的函数在末尾加上threads参数：调用期间在当前线程上应用执行上下文
+template <typename R, typename... Args>
+std::function<R(Args..., int)> with_context(R (*f)(Args...))
+{
+    return [f](Args... args, int threads) -> R {
+        ScopedExecution scope(current_context(threads));
+        return f(std::forward<Args>(args)...);
+    };
+}
+
+// 设置进程默认的OpenMP线程数，对之后所有线程上的调用生效；单次调用可以用threads参数覆盖
+void set_omp_threads(int num_threads)
+{
+    if (num_threads <= 0)
+    {
+        throw std::runtime_error("线程数必须大于0");
+    }
+    default_omp_threads = num_threads;
+}
+
+// 获取OpenMP线程数的函数
+int get_omp_threads()
+{
+    int threads = default_omp_threads.load();
+    return threads > 0 ? threads : omp_get_max_threads();
+}
+
+// ===================== 扩展性基准测试 =====================
+// 图像读入内存后只计时计算部分：每个线程数先预热，再重复多次取中位数与p95，
+// 由中位数得到加速比与并行效率，并按Amdahl定律 T(p) = T(1) * (f + (1 - f) / p) 拟合串行比例f
+
+// 在内存中的图像上执行一次算子
+typedef std::function<void(const ImageView &, const ImageView &)> KernelRunner;
+
+// 算子与参数：("grayscale",) ("binary", threshold) ("binary_auto"[, method[, classes]]) ("brightness", delta)
+//            ("point_ops", [调整, ...]) ("gaussian", kernel_size, sigma[, method])
+//            ("sobel",) ("canny", low, high[, kernel_size, sigma]) ("convolution", kernel[, divisor[, method]])，
+//            out_channels返回输出通道数
+template <typename Policy>
+KernelRunner make_kernel_runner(const std::string &op, const std::vector<py::object> &params, int &out_channels)
+{
+    auto expect_args = [&](size_t min_args, size_t max_args) {
+        if (params.size() < min_args || params.size() > max_args)
+        {
+            throw std::runtime_error("基准测试算子参数数量错误: " + op);
+        }
+    };
+    out_channels = 3;
+    if (op == "grayscale")
+    {
+        expect_args(0, 0);
+        out_channels = 1;
+        return [](const ImageView &src, const ImageView &dst) { grayscale_kernel<Policy>(src, dst); };
+    }
+    if (op == "binary")
+    {
+        expect_args(1, 1);
+        int threshold = params[0].cast<int>();
+        out_channels = 1;
+        return [threshold](const ImageView &src, const ImageView &dst) { binary_kernel<Policy>(src, dst, threshold); };
+    }
+    if (op == "binary_auto")
+    {
+        expect_args(0, 2);
+        ThresholdMethod method = parse_threshold_method(params.size() > 0 ? params[0].cast<std::string>() : "otsu");
+        int classes = params.size() > 1 ? params[1].cast<int>() : 2;
+        out_channels = 1;
+        return [=](const ImageView &src, const ImageView &dst) {
+            auto_binary_kernel<Policy>(src, dst, method, classes);
+        };
+    }
+    if (op == "brightness")
+    {
+        expect_args(1, 1);
+        int delta = params[0].cast<int>();
+        return [delta](const ImageView &src, const ImageView &dst) { brightness_kernel<Policy>(src, dst, delta); };
+    }
+    if (op == "point_ops")
+    {
+        expect_args(1, 1);
+        PointLut lut = parse_point_ops(params[0].cast<std::vector<std::vector<py::object>>>());
+        return [lut](const ImageView &src, const ImageView &dst) { lut_kernel<Policy>(src, dst, lut); };
+    }
+    if (op == "gaussian")
+    {
+        expect_args(2, 3);
+        int size = params[0].cast<int>();
+        float sigma = params[1].cast<float>();
+        GaussianMethod method = parse_gaussian_method(params.size() > 2 ? params[2].cast<std::string>() : "auto");
+        return [=](const ImageView &src, const ImageView &dst) { gaussian_blur_kernel<Policy>(src, dst, size, sigma, method); };
+    }
+    if (op == "sobel")
+    {
+        expect_args(0, 0);
+        return [](const ImageView &src, const ImageView &dst) { sobel_kernel<Policy>(src, dst); };
+    }
+    if (op == "canny")
+    {
+        expect_args(2, 4);
+        double low = params[0].cast<double>(), high = params[1].cast<double>();
+        int size = params.size() > 2 ? params[2].cast<int>() : 5;
+        float sigma = params.size() > 3 ? params[3].cast<float>() : 1.4f;
+        out_channels = 1;
+        return [=](const ImageView &src, const ImageView &dst) {
+            canny_kernel<Policy>(src, dst, low, high, size, sigma, false);
+        };
+    }
+    if (op == "convolution")
+    {
+        expect_args(1, 3);
+        std::vector<std::vector<float>> kernel = params[0].cast<std::vector<std::vector<float>>>();
+        float divisor = params.size() > 1 ? params[1].cast<float>() : 1.0f;
+        ConvolutionMethod method =
+            parse_convolution_method(params.size() > 2 ? params[2].cast<std::string>() : "auto");
+        int kh, kw;
+        flatten_convolution_kernel(kernel, divisor, kh, kw); // 提前检查卷积核，不合法时在计时开始前报错
+        return [=](const ImageView &src, const ImageView &dst) {
+            custom_convolution_kernel<Policy>(src, dst, kernel, divisor, method);
+        };
+    }
+    throw std::runtime_error("未知的基准测试算子: " + op);
+}
+
+// 按名字选择执行策略："runtime"（默认，调度方式沿用执行上下文）、"static"、"dynamic"、"task"或"serial"
+KernelRunner make_kernel_runner(const std::string &policy, const std::string &op, const std::vector<py::object> &params,
+                                int &out_channels)
+{
+    if (policy == "runtime")
+        return make_kernel_runner<OmpRuntimePolicy>(op, params, out_channels);
+    if (policy == "static")
+        return make_kernel_runner<OmpStaticPolicy>(op, params, out_channels);
+    if (policy == "dynamic")
+        return make_kernel_runner<OmpDynamicPolicy>(op, params, out_channels);
+    if (policy == "task")
+        return make_kernel_runner<OmpTaskPolicy>(op, params, out_channels);
+    if (policy == "serial")
+        return make_kernel_runner<SerialPolicy>(op, params, out_channels);
+    throw std::runtime_error("未知的执行策略: " + policy);
+}
+
+// 一个线程数下的测量结果，时间单位为秒
+struct ScalingPoint
+{
+    int threads;
+    std::vector<double> samples;
+    double median, p95, min;
+};
+
+// 已排序样本的第q分位数（最近秩法）
+static double sorted_quantile(const std::vector<double> &sorted, double q)
+{
+    size_t rank = (size_t)std::ceil(q * sorted.size());
+    return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+// 由各线程数下的中位时间最小二乘拟合Amdahl串行比例：记r = T(p) / T(1)，则 r - 1/p = f * (1 - 1/p)
+static double fit_serial_fraction(const std::vector<ScalingPoint> &points)
+{
+    double t1 = points[0].median, num = 0, den = 0;
+    for (const ScalingPoint &pt : points)
+    {
+        if (pt.threads < 2)
+            continue;
+        double a = 1.0 - 1.0 / pt.threads;
+        num += a * (pt.median / t1 - 1.0 / pt.threads);
+        den += a * a;
+    }
+    if (den == 0 || t1 <= 0)
+        return 0.0;
+    return std::min(std::max(num / den, 0.0), 1.0);
+}
+
+// 在线程数1..max_threads（0表示CPU核数）上测量一个算子的强扩展性，CPU绑定沿用当前执行上下文；
+// policy选择执行策略，各策略运行的是同一份计算核心，只是循环的调度方式不同
+py::dict benchmark_py(const std::string &op, const std::vector<py::object> &params, const std::string &input,
+                      int repetitions, int warmup, int max_threads, const std::string &policy)
+{
+    if (repetitions <= 0 || warmup < 0)
+    {
+        throw std::runtime_error("重复次数必须大于0，预热次数不能为负数");
+    }
+    if (max_threads <= 0)
+        max_threads = omp_get_num_procs();
+    int out_channels;
+    KernelRunner runner = make_kernel_runner(policy, op, params, out_channels);
+
+    std::vector<ScalingPoint> points;
+    int width, height;
+    {
+        py::gil_scoped_release release;
+        // 输入复制到进程内的缓冲区，输出缓冲区也只分配一次，计时中不含任何磁盘I/O与缺页
+        BmpReader in(input);
+        require_24bit(in, "仅支持24位RGB图像进行基准测试");
+        width = in.width();
+        height = in.height();
+        ImageView mapped = in.view();
+        std::vector<unsigned char> srcBuf((size_t)width * height * 3);
+        std::vector<unsigned char> dstBuf((size_t)width * height * out_channels);
+        ImageView src = {srcBuf.data(), width, height, (ptrdiff_t)width * 3, 3};
+        ImageView dst = {dstBuf.data(), width, height, (ptrdiff_t)width * out_channels, out_channels};
+        for (int y = 0; y < height; y++)
+            memcpy(src.row(y), mapped.row(y), (size_t)width * 3);
+
+        for (int t = 1; t <= max_threads; t++)
+        {
+            ScopedExecution scope(current_context(t));
+            ScalingPoint pt;
+            pt.threads = t;
+            for (int i = 0; i < warmup; i++)
+                runner(src, dst);
+            for (int i = 0; i < repetitions; i++)
+            {
+                double start = omp_get_wtime();
+                runner(src, dst);
+                pt.samples.push_back(omp_get_wtime() - start);
+            }
+            std::vector<double> sorted = pt.samples;
+            std::sort(sorted.begin(), sorted.end());
+            pt.median = sorted_quantile(sorted, 0.5);
+            pt.p95 = sorted_quantile(sorted, 0.95);
+            pt.min = sorted.front();
+            points.push_back(pt);
+        }
+    }
+
+    double t1 = points[0].median;
+    py::list results;
+    for (const ScalingPoint &pt : points)
+    {
+        double speedup = pt.median > 0 ? t1 / pt.median : 0.0;
+        py::dict d;
+        d["threads"] = pt.threads;
+        d["median"] = pt.median;
+        d["p95"] = pt.p95;
+        d["min"] = pt.min;
+        d["speedup"] = speedup;
+        d["efficiency"] = speedup / pt.threads;
+        d["samples"] = pt.samples;
+        results.append(d);
+    }
+
+    // 串行比例f对应的加速比上限为1/f
+    double f = fit_serial_fraction(points);
+    py::dict result;
+    result["op"] = op;
+    result["policy"] = policy;
+    result["width"] = width;
+    result["height"] = height;
+    result["repetitions"] = repetitions;
+    result["warmup"] = warmup;
+    result["results"] = results;
+    result["serial_fraction"] = f;
+    if (f > 0)
+        result["max_speedup"] = 1.0 / f;
+    else
+        result["max_speedup"] = py::none();
+    return result;
+}
+
+// 计时记录中的硬件计数转为字典：各计数器之和、每线程的计数，以及IPC与每千条指令的LLC缺失数。
+// 未采集时返回None，不可用的计数为None
+py::object perf_counters_dict(const Timing &t)
+{
+    if (t.thread_counters.empty())
+        return py::none();
+    auto to_dict = [](const PerfCounts &c) {
+        py::dict d;
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        {
+            if (c.value[i] >= 0)
+                d[perf_counter_names[i]] = c.value[i];
+            else
+                d[perf_counter_names[i]] = py::none();
+        }
+        return d;
+    };
+    const long long *v = t.counters.value;
+    py::dict d = to_dict(t.counters);
+    if (v[PERF_CYCLES] > 0 && v[PERF_INSTRUCTIONS] >= 0)
+        d["ipc"] = (double)v[PERF_INSTRUCTIONS] / v[PERF_CYCLES];
+    else
+        d["ipc"] = py::none();
+    if (v[PERF_INSTRUCTIONS] > 0 && v[PERF_LLC_MISSES] >= 0)
+        d["llc_mpki"] = 1000.0 * v[PERF_LLC_MISSES] / v[PERF_INSTRUCTIONS];
+    else
+        d["llc_mpki"] = py::none();
+    py::list per_thread;
+    for (const PerfCounts &c : t.thread_counters)
+        per_thread.append(to_dict(c));
+    d["per_thread"] = per_thread;
+    return d;
+}
+
+// pybind11模块定义
+PYBIND11_MODULE(image_processing, m)
+{
+    m.doc() = "OpenMP加速的图像处理模块"; // 模块文档字符串
+
+    // 设置OpenMP线程数
+    m.def("set_omp_threads", &set_omp_threads, "设置OpenMP线程数",
+          py::arg("num_threads"));
+
+    // 获取OpenMP线程数
+    m.def("get_omp_threads", &get_omp_threads, "获取OpenMP最大线程数");
+
+    // 执行上下文：with ExecutionContext(threads=4, schedule="dynamic", cpus=[0, 1, 2, 3]): ...
+    // 只作用于当前线程在with块内的调用；各处理函数的threads参数可以再覆盖线程数
+    py::class_<ExecutionContext>(m, "ExecutionContext", "限定在当前线程上的线程数、调度方式与CPU绑定")
+        .def(py::init([](int threads, const std::string &schedule, int chunk, const std::vector<int> &cpus) {
+                 ExecutionContext ctx;
+                 ctx.threads = threads;
+                 ctx.schedule = schedule;
+                 ctx.chunk = chunk;
+                 ctx.cpus = cpus;
+                 return ctx;
+             }),
+             py::arg("threads") = 0, py::arg("schedule") = "", py::arg("chunk") = 0,
+             py::arg("cpus") = std::vector<int>())
+        .def_readwrite("threads", &ExecutionContext::threads)
+        .def_readwrite("schedule", &ExecutionContext::schedule)
+        .def_readwrite("chunk", &ExecutionContext::chunk)
+        .def_readwrite("cpus", &ExecutionContext::cpus)
+        .def("__enter__", [](const ExecutionContext &ctx) {
+            if (!ctx.schedule.empty())
+                parse_schedule(ctx.schedule);
+            // 嵌套时未指定的字段沿用外层上下文
+            ExecutionContext merged = ctx;
+            if (!context_stack.empty())
+            {
+                const ExecutionContext &outer = context_stack.back();
+                if (merged.threads <= 0)
+                    merged.threads = outer.threads;
+                if (merged.schedule.empty())
+                {
+                    merged.schedule = outer.schedule;
+                    merged.chunk = outer.chunk;
+                }
+                if (merged.cpus.empty())
+                    merged.cpus = outer.cpus;
+            }
+            context_stack.push_back(merged);
+            return ctx;
+        })
+        .def("__exit__", [](const ExecutionContext &, py::object, py::object, py::object) {
+            if (!context_stack.empty())
+                context_stack.pop_back();
+        });
+
+    // 各文件处理函数返回的分阶段计时，float(t)为总耗时，与原先返回的秒数兼容
+    py::class_<Timing>(m, "Timing", "分阶段计时（秒）：文件头解析、读入、分配、计算、写出与总耗时")
+        .def_readonly("header", &Timing::header)
+        .def_readonly("read", &Timing::read)
+        .def_readonly("allocation", &Timing::allocation)
+        .def_readonly("compute", &Timing::compute)
+        .def_readonly("write", &Timing::write)
+        .def_readonly("total", &Timing::total)
+        .def_readonly("pixels", &Timing::pixels)
+        .def_readonly("bytes", &Timing::bytes)
+        .def_property_readonly("mb_per_second", &Timing::mb_per_second)
+        .def_property_readonly("counters", &perf_counters_dict)
+        .def("__float__", [](const Timing &t) { return t.total; })
+        .def("to_dict", [](const Timing &t) {
+            py::dict d;
+            d["header"] = t.header;
+            d["read"] = t.read;
+            d["allocation"] = t.allocation;
+            d["compute"] = t.compute;
+            d["write"] = t.write;
+            d["total"] = t.total;
+            d["pixels"] = t.pixels;
+            d["bytes"] = t.bytes;
+            d["mb_per_second"] = t.mb_per_second();
+            d["counters"] = perf_counters_dict(t);
+            return d;
+        })
+        .def("__repr__", [](const Timing &t) {
+            char buf[256];
+            snprintf(buf, sizeof(buf),
+                     "Timing(total=%.6f, header=%.6f, read=%.6f, allocation=%.6f, compute=%.6f, write=%.6f, "
+                     "mb_per_second=%.1f)",
+                     t.total, t.header, t.read, t.allocation, t.compute, t.write, t.mb_per_second());
+            return std::string(buf);
+        });
+
+    // 硬件性能计数器开关，开启后各处理函数返回的计时记录带有counters
+    m.def("set_perf_counters", &set_perf_counters, "开启或关闭计算阶段的硬件性能计数器（perf_event_open）",
+          py::arg("enabled"));
+    m.def("get_perf_counters", &get_perf_counters, "硬件性能计数器是否开启");
+
+    // 获取点运算使用的SIMD指令集
+    m.def("get_simd_isa", &get_simd_isa, "获取灰度/二值化/亮度调整/查找表当前使用的SIMD指令集");
+
+    // RGB转灰度图
+    m.def("convert_to_grayscale", with_context(&convert_to_grayscale_py<OmpRuntimePolicy>),
+          "将RGB图像转换为灰度图",
+          py::arg("input"), py::arg("output"),
+          py::arg("threads") = 0, py::call_guard<py::gil_scoped_release>());
+
+    // RGB转二值图
+    m.def("convert_to_binary", with_context(&convert_to_binary_py<OmpRuntimePolicy>),
+          "将RGB图像转换为二值图",
+          py::arg("input"), py::arg("output"), py::arg("threshold"),
+          py::arg("threads") = 0, py::call_guard<py::gil_scoped_release>());
+
+    // 自动阈值二值化：一遍读入同时统计直方图，返回{"threshold", "thresholds", "histogram", "timing"}
+    // method为"otsu"或"triangle"；classes大于2时为多级Otsu，输出classes个均匀分布的灰度级
+    m.def("convert_to_binary_auto", with_context(&convert_to_binary_auto_py<OmpRuntimePolicy>),
+          "按自动选出的阈值将RGB图像转换为二值图，并返回阈值与亮度直方图",
+          py::arg("input"), py::arg("output"), py::arg("method") = "otsu", py::arg("classes") = 2,
+          py::arg("threads") = 0);
+
+    // 亮度调整
+    m.def("adjust_brightness", with_context(&adjust_brightness_py<OmpRuntimePolicy>),
+          "调整图像亮度",
+          py::arg("input"), py::arg("output"), py::arg("delta"),
+          py::arg("threads") = 0, py::call_guard<py::gil_scoped_release>());
+
+    // 查找表色调调整，例如ops=[("levels", 16, 235), ("contrast", 1.2), ("gamma", 0.8)]，全部调整复合成一张表
+    m.def("apply_point_ops", with_context(&apply_point_ops_py<OmpRuntimePolicy>),
+          "将一串色调调整（亮度、对比度、gamma、色阶、曲线、查找表）复合成查找表后一遍应用",
+          py::arg("input"), py::arg("output"), py::arg("ops"),
+          py::arg("threads") = 0);
+
+    m.def("build_point_lut", &build_point_lut,
+          "返回一串色调调整复合后的3x256查找表（B、G、R各一行）",
+          py::arg("ops"));
+
+    // 高斯模糊
+    // method: "auto"（默认）、"separable"（两遍一维卷积）或"recursive"（递归IIR，与核大小无关）
+    m.def("apply_gaussian_blur", with_context(&apply_gaussian_blur_py<OmpRuntimePolicy>),
+          "应用高斯模糊",
+          py::arg("input"), py::arg("output"), py::arg("kernel_size"), py::arg("sigma"),
+          py::arg("method") = "auto",
+          py::arg("threads") = 0, py::call_guard<py::gil_scoped_release>());
+
+    // 自定义卷积
+    m.def("apply_custom_convolution", with_context(&apply_custom_convolution_py<OmpRuntimePolicy>),
+          "应用自定义卷积滤波器",
+          py::arg("input"), py::arg("output"), py::arg("kernel"), py::arg("divisor"),
+          py::arg("method") = "auto",
+          py::arg("threads") = 0, py::call_guard<py::gil_scoped_release>());
+
+    // Sobel边缘检测
+    m.def("apply_sobel_edge_detection", with_context(&apply_sobel_edge_detection_py<OmpRuntimePolicy>),
+          "应用Sobel边缘检测；single_channel为True时输出8位单通道BMP",
+          py::arg("input"), py::arg("output"), py::arg("single_channel") = false,
+          py::arg("threads") = 0, py::call_guard<py::gil_scoped_release>());
+
+    // Canny边缘检测，阈值含义与cv2.Canny相同；kernel_size为0时不做高斯平滑
+    m.def("apply_canny_edge_detection", with_context(&apply_canny_edge_detection_py<OmpRuntimePolicy>),
+          "应用Canny边缘检测，输出8位单通道BMP（边缘为255）",
+          py::arg("input"), py::arg("output"), py::arg("low_threshold"), py::arg("high_threshold"),
+          py::arg("kernel_size") = 5, py::arg("sigma") = 1.4f, py::arg("l2_gradient") = false,
+          py::arg("threads") = 0, py::call_guard<py::gil_scoped_release>());
+
+    // 融合流水线，例如ops=[("gaussian", 5, 1.2), ("sobel",)]
+    m.def("run_pipeline", with_context(&run_pipeline_py),
+          "按图块融合执行一串算子，中间结果不落盘；memory_budget_mb大于0时按条带流式读写，预算包含条带缓冲与各线程的图块缓冲",
+          py::arg("input"), py::arg("output"), py::arg("ops"), py::arg("memory_budget_mb") = 0.0,
+          py::arg("threads") = 0);
+
+    // 批处理，例如process_batch("gaussian", [5, 1.2], [("a.bmp", "a_out.bmp"), ...])
+    m.def("process_batch", with_context(&process_batch_py),
+          "批量处理多个文件，读、算、写三级流水重叠执行，返回每个文件与整批的耗时和吞吐量",
+          py::arg("op"), py::arg("params"), py::arg("files"),
+          py::arg("threads") = 0);
+
+    // 扩展性基准测试，例如benchmark("gaussian", [15, 3.0], "a.bmp", repetitions=20)
+    m.def("benchmark", &benchmark_py,
+          "在内存中的图像上按线程数1..max_threads测量算子耗时，返回中位数/p95、加速比、并行效率与Amdahl串行比例",
+          py::arg("op"), py::arg("params"), py::arg("input"), py::arg("repetitions") = 10, py::arg("warmup") = 2,
+          py::arg("max_threads") = 0, py::arg("policy") = "runtime");
+
+    // 图像拼接
+    m.def("stitch_images_surf", with_context(&stitch_images_surf_py<OmpRuntimePolicy>),
+          "使用SURF特征进行图像拼接；feature_resolution大于0时在长边为该值的缩小图上检测特征，再在原分辨率上精化；"
+          "blend为\"feather\"（线性过渡）或\"multiband\"（多频段融合）",
+          py::arg("input1"), py::arg("input2"), py::arg("output"), py::arg("feature_resolution") = 0,
+          py::arg("blend") = "feather",
+          py::arg("threads") = 0, py::call_guard<py::gil_scoped_release>());
+
+    // 多张图像拼接，inputs按相邻顺序排列
+    m.def("stitch_many", with_context(&stitch_many_py<OmpRuntimePolicy>),
+          "将多张按顺序相邻的图像拼接成一幅全景图，每张图只变换一次",
+          py::arg("inputs"), py::arg("output"), py::arg("feature_resolution") = 0,
+          py::arg("threads") = 0, py::call_guard<py::gil_scoped_release>());
+
+    // NumPy数组版本（与文件路径版本同名重载，直接返回处理后的数组）。
+    // image不做类型转换：非uint8数组（例如float图像）不会被悄悄截断成uint8，而是报参数类型错误
+    m.def("convert_to_grayscale", with_context(&convert_to_grayscale_array),
+          "将RGB图像数组转换为灰度图数组",
+          py::arg("image").noconvert(),
+          py::arg("threads") = 0);
+
+    m.def("convert_to_binary", with_context(&convert_to_binary_array),
+          "将RGB图像数组转换为二值图数组",
+          py::arg("image").noconvert(), py::arg("threshold"),
+          py::arg("threads") = 0);
+
+    m.def("convert_to_binary_auto", with_context(&convert_to_binary_auto_array),
+          "按自动选出的阈值将RGB图像数组转换为二值图数组，结果在返回字典的image中",
+          py::arg("image").noconvert(), py::arg("method") = "otsu", py::arg("classes") = 2,
+          py::arg("threads") = 0);
+
+    m.def("adjust_brightness", with_context(&adjust_brightness_array),
+          "调整图像数组亮度",
+          py::arg("image").noconvert(), py::arg("delta"),
+          py::arg("threads") = 0);
+
+    m.def("apply_point_ops", with_context(&apply_point_ops_array),
+          "对图像数组应用一串复合成查找表的色调调整",
+          py::arg("image").noconvert(), py::arg("ops"),
+          py::arg("threads") = 0);
+
+    // 原地版本：直接改写传入的uint8数组，不做类型转换（否则改写的会是临时副本）
+    m.def("apply_point_ops_inplace", with_context(&apply_point_ops_inplace),
+          "原地对图像数组应用一串复合成查找表的色调调整",
+          py::arg("image").noconvert(), py::arg("ops"),
+          py::arg("threads") = 0);
+
+    m.def("apply_gaussian_blur", with_context(&apply_gaussian_blur_array),
+          "对图像数组应用高斯模糊",
+          py::arg("image").noconvert(), py::arg("kernel_size"), py::arg("sigma"), py::arg("method") = "auto",
+          py::arg("threads") = 0);
+
+    m.def("apply_custom_convolution", with_context(&apply_custom_convolution_array),
+          "对图像数组应用自定义卷积滤波器",
+          py::arg("image").noconvert(), py::arg("kernel"), py::arg("divisor"), py::arg("method") = "auto",
+          py::arg("threads") = 0);
+
+    m.def("apply_sobel_edge_detection", with_context(&apply_sobel_edge_detection_array),
+          "对图像数组应用Sobel边缘检测；single_channel为True时返回HxW数组",
+          py::arg("image").noconvert(), py::arg("single_channel") = false,
+          py::arg("threads") = 0);
+
+    m.def("apply_canny_edge_detection", with_context(&apply_canny_edge_detection_array),
+          "对图像数组应用Canny边缘检测，返回HxW数组（边缘为255）",
+          py::arg("image").noconvert(), py::arg("low_threshold"), py::arg("high_threshold"),
+          py::arg("kernel_size") = 5, py::arg("sigma") = 1.4f, py::arg("l2_gradient") = false,
+          py::arg("threads") = 0);
+
+    m.def("run_pipeline", with_context(&run_pipeline_array),
+          "对图像数组按图块融合执行一串算子",
+          py::arg("image").noconvert(), py::arg("ops"),
+          py::arg("threads") = 0);
+
+    // 串行版本：与上面同一份模板以SerialPolicy实例化，只是不进入并行区域
+    m.def("convert_to_grayscale_serial", &convert_to_grayscale_py<SerialPolicy>,
+          "将RGB图像转换为灰度图（串行版本）",
+          py::arg("input"), py::arg("output"), py::call_guard<py::gil_scoped_release>());
+
+    m.def("convert_to_binary_serial", &convert_to_binary_py<SerialPolicy>,
+          "将RGB图像转换为二值图（串行版本）",
+          py::arg("input"), py::arg("output"), py::arg("threshold"), py::call_guard<py::gil_scoped_release>());
+
+    m.def("convert_to_binary_auto_serial", &convert_to_binary_auto_py<SerialPolicy>,
+          "按自动选出的阈值将RGB图像转换为二值图（串行版本）",
+          py::arg("input"), py::arg("output"), py::arg("method") = "otsu", py::arg("classes") = 2);
+
+    m.def("adjust_brightness_serial", &adjust_brightness_py<SerialPolicy>,
+          "调整图像亮度（串行版本）",
+          py::arg("input"), py::arg("output"), py::arg("delta"), py::call_guard<py::gil_scoped_release>());
+
+    m.def("apply_point_ops_serial", &apply_point_ops_py<SerialPolicy>,
+          "将一串色调调整复合成查找表后一遍应用（串行版本）",
+          py::arg("input"), py::arg("output"), py::arg("ops"));
+
+    m.def("apply_gaussian_blur_serial", &apply_gaussian_blur_py<SerialPolicy>,
+          "应用高斯模糊（串行版本）",
+          py::arg("input"), py::arg("output"), py::arg("kernel_size"), py::arg("sigma"),
+          py::arg("method") = "auto", py::call_guard<py::gil_scoped_release>());
+
+    m.def("apply_custom_convolution_serial", &apply_custom_convolution_py<SerialPolicy>,
+          "应用自定义卷积滤波器（串行版本）",
+          py::arg("input"), py::arg("output"), py::arg("kernel"), py::arg("divisor"),
+          py::arg("method") = "auto", py::call_guard<py::gil_scoped_release>());
+
+    m.def("apply_sobel_edge_detection_serial", &apply_sobel_edge_detection_py<SerialPolicy>,
+          "应用Sobel边缘检测（串行版本）",
+          py::arg("input"), py::arg("output"), py::arg("single_channel") = false,
+          py::call_guard<py::gil_scoped_release>());
+
+    m.def("apply_canny_edge_detection_serial", &apply_canny_edge_detection_py<SerialPolicy>,
+          "应用Canny边缘检测（串行版本）",
+          py::arg("input"), py::arg("output"), py::arg("low_threshold"), py::arg("high_threshold"),
+          py::arg("kernel_size") = 5, py::arg("sigma") = 1.4f, py::arg("l2_gradient") = false,
+          py::call_guard<py::gil_scoped_release>());
+
+    // 特征检测（ORB）与findHomography在OpenCV内部执行，不受执行策略影响
+    m.def("stitch_images_surf_serial", &stitch_images_surf_py<SerialPolicy>,
+          "使用SURF特征进行图像拼接（串行版本）",
+          py::arg("input1"), py::arg("input2"), py::arg("output"), py::arg("feature_resolution") = 0,
+          py::arg("blend") = "feather", py::call_guard<py::gil_scoped_release>());
+
+    m.def("stitch_many_serial", &stitch_many_py<SerialPolicy>,
+          "将多张按顺序相邻的图像拼接成一幅全景图（串行版本）",
+          py::arg("inputs"), py::arg("output"), py::arg("feature_resolution") = 0,
+          py::call_guard<py::gil_scoped_release>());
 }
\ No newline at end of file